@@ -0,0 +1,360 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "contact.hpp"
+#include "file_contact_repository.hpp"
+#include "phone_number.hpp"
+
+namespace
+{
+    constexpr int kContacts = 200000;
+    constexpr int kRounds = 3;
+
+    // Loader used for contacts.txt before the mmap/parallel one: QTextStream::readLine
+    // on the calling thread and a QString split per field.
+    std::vector<QString> splitEscaped(const QString &line, QChar delimiter)
+    {
+        std::vector<QString> parts;
+        QString cur;
+        bool esc = false;
+
+        for (const QChar ch : line)
+        {
+            if (!esc && ch == '\\')
+            {
+                esc = true;
+                continue;
+            }
+
+            if (!esc && ch == delimiter)
+            {
+                parts.push_back(cur);
+                cur.clear();
+                continue;
+            }
+
+            cur.append(ch);
+            esc = false;
+        }
+
+        parts.push_back(cur);
+        return parts;
+    }
+
+    QString unescapeField(const QString &value)
+    {
+        QString out;
+        out.reserve(value.size());
+        bool esc = false;
+        for (const QChar ch : value)
+        {
+            if (!esc && ch == '\\')
+            {
+                esc = true;
+                continue;
+            }
+            out.append(ch);
+            esc = false;
+        }
+        return out;
+    }
+
+    std::vector<PhoneNumber> deserializePhones(const QString &value)
+    {
+        std::vector<PhoneNumber> phones;
+        for (const auto &item : splitEscaped(value, ','))
+        {
+            if (item.isEmpty())
+                continue;
+
+            const auto pair = splitEscaped(item, ':');
+            if (pair.size() != 2)
+                continue;
+
+            phones.emplace_back(PhoneNumber::stringToType(pair[0]), unescapeField(pair[1]));
+        }
+        return phones;
+    }
+
+    bool deserializeContact(const QString &line, Contact &outContact)
+    {
+        const auto fields = splitEscaped(line, '|');
+        if (fields.size() < 7)
+            return false;
+
+        Contact c;
+        c.setFirstName(unescapeField(fields[0]).trimmed());
+        c.setLastName(unescapeField(fields[1]).trimmed());
+        c.setMiddleName(unescapeField(fields[2]).trimmed());
+        c.setAddress(unescapeField(fields[3]).trimmed());
+        const QString date = unescapeField(fields[4]).trimmed();
+        c.setBirthDate(date.isEmpty() ? QDate() : QDate::fromString(date, "dd.MM.yyyy"));
+        c.setEmail(unescapeField(fields[5]).trimmed());
+        c.setPhoneNumbers(deserializePhones(fields[6]));
+
+        if (c.firstName().isEmpty() || c.lastName().isEmpty() || c.email().isEmpty() || c.phoneNumbers().empty())
+            return false;
+
+        outContact = std::move(c);
+        return true;
+    }
+
+    std::vector<Contact> loadLineByLine(const QString &path)
+    {
+        std::vector<Contact> contacts;
+
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+            return contacts;
+
+        QTextStream in(&file);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        in.setEncoding(QStringConverter::Utf8);
+#else
+        in.setCodec("UTF-8");
+#endif
+
+        while (!in.atEnd())
+        {
+            const QString line = in.readLine();
+            if (line.trimmed().isEmpty())
+                continue;
+
+            Contact c;
+            if (deserializeContact(line, c))
+                contacts.push_back(std::move(c));
+        }
+        return contacts;
+    }
+
+    std::vector<Contact> sampleContacts()
+    {
+        const QString firstNames[] = {"Константин", "Anna", "Семён", "Maria"};
+        const QString lastNames[] = {"Константинопольский", "Smith", "Ivanova", "O'Neil"};
+
+        std::vector<Contact> contacts;
+        contacts.reserve(kContacts);
+        for (int i = 0; i < kContacts; ++i)
+        {
+            Contact c;
+            c.setId(1000000 + i);
+            c.setFirstName(firstNames[i % 4]);
+            c.setLastName(lastNames[(i / 4) % 4]);
+            c.setMiddleName(i % 3 == 0 ? QString() : QStringLiteral("Александрович"));
+            // Every tenth address carries the field and phone separators to exercise escaping.
+            c.setAddress(i % 10 == 0 ? QStringLiteral("Moscow, Tverskaya 12|%1 \\ b").arg(i)
+                                     : QStringLiteral("Moscow, Tverskaya street 12-%1").arg(i));
+            if (i % 5 != 0)
+                c.setBirthDate(QDate(1950 + i % 60, 1 + i % 12, 1 + i % 28));
+            c.setEmail(QStringLiteral("user%1@example.com").arg(i));
+            c.setPhoneNumbers({PhoneNumber(PhoneType::Work, QStringLiteral("+7 (916) %1").arg(1000000 + i)),
+                               PhoneNumber(PhoneType::Home, QStringLiteral("8-495-765-43-21"))});
+            contacts.push_back(std::move(c));
+        }
+        return contacts;
+    }
+
+    bool sameContact(const Contact &a, const Contact &b)
+    {
+        if (a.firstName() != b.firstName() || a.lastName() != b.lastName() || a.middleName() != b.middleName() ||
+            a.address() != b.address() || a.birthDate() != b.birthDate() || a.email() != b.email() ||
+            a.phoneNumbers().size() != b.phoneNumbers().size())
+            return false;
+
+        for (std::size_t i = 0; i < a.phoneNumbers().size(); ++i)
+        {
+            const PhoneNumber &pa = a.phoneNumbers()[i];
+            const PhoneNumber &pb = b.phoneNumbers()[i];
+            if (pa.type() != pb.type() || pa.value() != pb.value())
+                return false;
+        }
+        return true;
+    }
+
+    bool sameContacts(const char *name, const std::vector<Contact> &expected, const std::vector<Contact> &loaded)
+    {
+        if (expected.size() != loaded.size())
+        {
+            std::printf("MISMATCH: %s loaded %zu contacts, expected %zu\n", name, loaded.size(), expected.size());
+            return false;
+        }
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            if (!sameContact(expected[i], loaded[i]))
+            {
+                std::printf("MISMATCH: %s contact %zu differs from the saved one\n", name, i);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sameContactsWithIds(const char *name, const std::vector<Contact> &expected, const std::vector<Contact> &loaded)
+    {
+        if (!sameContacts(name, expected, loaded))
+            return false;
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            if (loaded[i].id() != expected[i].id())
+            {
+                std::printf("MISMATCH: %s contact %zu has id %lld, expected %lld\n", name, i,
+                            static_cast<long long>(loaded[i].id()), static_cast<long long>(expected[i].id()));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<Contact> reload(const QString &path, FileContactRepository::Format format, QString &error)
+    {
+        FileContactRepository repo(path, format);
+        repo.setJournaled(true);
+        std::vector<Contact> contacts = repo.loadAll();
+        error = repo.lastError();
+        return contacts;
+    }
+
+    bool appendRaw(const QString &path, const QByteArray &bytes)
+    {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly | QIODevice::Append) && file.write(bytes) == bytes.size();
+    }
+
+    // Saves a snapshot, journals upserts and removes on top of it and reloads
+    // with a fresh repository: the result must match the same changes applied
+    // to a plain vector. A torn final record is dropped; a bad record followed
+    // by more data fails the load.
+    bool checkJournal(const QString &path, FileContactRepository::Format format, std::vector<Contact> expected)
+    {
+        const char *name = (format == FileContactRepository::Format::Text) ? "text journal" : "binary journal";
+        {
+            FileContactRepository repo(path, format);
+            repo.setJournaled(true);
+            repo.saveAll(expected);
+
+            std::vector<ContactChange> changes;
+            for (std::size_t i = 0; i < expected.size(); i += 7)
+            {
+                expected[i].setAddress(QStringLiteral("Journaled, %1 | street").arg(i));
+                changes.push_back(ContactChange::upsert(expected[i]));
+            }
+            for (std::size_t i = 3; i < expected.size(); i += 11)
+                changes.push_back(ContactChange::remove(expected[i].id()));
+            for (int i = 0; i < 100; ++i)
+            {
+                Contact c = expected[static_cast<std::size_t>(i)];
+                c.setId(9000000 + i);
+                changes.push_back(ContactChange::upsert(c));
+            }
+
+            const QString error = repo.applyChanges(changes).result();
+            if (!error.isEmpty() || !repo.lastError().isEmpty())
+            {
+                std::printf("%s: applyChanges failed: %s\n", name, qPrintable(error + repo.lastError()));
+                return false;
+            }
+
+            for (const ContactChange &change : changes)
+            {
+                const auto it = std::find_if(expected.begin(), expected.end(), [&change](const Contact &c)
+                                             { return c.id() == change.id; });
+                if (change.kind == ContactChange::Kind::Remove)
+                    expected.erase(it);
+                else if (it == expected.end())
+                    expected.push_back(change.contact);
+            }
+        }
+
+        QString error;
+        if (!sameContactsWithIds(name, expected, reload(path, format, error)) || !error.isEmpty())
+            return false;
+
+        const QString journal = path + ".journal";
+        if (!appendRaw(journal, "999999|S|42|Torn|Rec"))
+            return false;
+        if (!sameContactsWithIds(name, expected, reload(path, format, error)) || !error.isEmpty())
+        {
+            std::printf("MISMATCH: %s with a torn final record\n", name);
+            return false;
+        }
+
+        if (!appendRaw(journal, "not a record\n999999|R|42\n"))
+            return false;
+        if (!reload(path, format, error).empty() || error.isEmpty())
+        {
+            std::printf("MISMATCH: %s with a corrupt record loaded instead of failing\n", name);
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Loader>
+    double run(const char *name, Loader load, qint64 bytes, std::vector<Contact> &contacts)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int round = 0; round < kRounds; ++round)
+            contacts = load();
+        const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9 / kRounds;
+
+        std::printf("%-12s %8.1f MB/s %12.0f contacts/s\n", name, bytes / (1024.0 * 1024.0) / seconds,
+                    contacts.size() / seconds);
+        return seconds;
+    }
+}
+
+int main()
+{
+    QLoggingCategory::setFilterRules("phonebook.file.info=false");
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+    {
+        std::printf("cannot create a temporary directory\n");
+        return 1;
+    }
+
+    const QString path = dir.filePath("contacts.txt");
+    const std::vector<Contact> contacts = sampleContacts();
+
+    FileContactRepository repo(path);
+    repo.saveAll(contacts);
+    if (!repo.lastError().isEmpty())
+    {
+        std::printf("cannot write %s: %s\n", qPrintable(path), qPrintable(repo.lastError()));
+        return 1;
+    }
+
+    const qint64 bytes = QFileInfo(path).size();
+    std::printf("input: %d contacts, %.1f MB, %d rounds\n", kContacts, bytes / (1024.0 * 1024.0), kRounds);
+
+    std::vector<Contact> oldLoaded;
+    std::vector<Contact> newLoaded;
+    const double oldSeconds = run("line-by-line", [&path]
+                                  { return loadLineByLine(path); },
+                                  bytes, oldLoaded);
+    const double newSeconds = run("mmap", [&repo]
+                                  { return repo.loadAll(); },
+                                  bytes, newLoaded);
+
+    if (!sameContacts("line-by-line", contacts, oldLoaded) || !sameContactsWithIds("mmap", contacts, newLoaded))
+        return 1;
+
+    std::printf("speedup: %.2fx\n", oldSeconds / newSeconds);
+
+    const std::vector<Contact> sample(contacts.begin(), contacts.begin() + 5000);
+    if (!checkJournal(dir.filePath("journaled.txt"), FileContactRepository::Format::Text, sample) ||
+        !checkJournal(dir.filePath("journaled.pbk"), FileContactRepository::Format::Binary, sample))
+        return 1;
+    std::printf("checks: journal replay, torn tail and corrupt record handling match the expected contacts\n");
+    return 0;
+}
@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = file_load_bench
+CONFIG += c++17 console release
+CONFIG -= app_bundle
+QT = core concurrent
+
+INCLUDEPATH += $$PWD/../include
+DEPENDPATH  += $$PWD/../include
+
+SOURCES += \
+    file_load_bench.cpp \
+    ../src/contact.cpp \
+    ../src/phone_number.cpp \
+    ../src/text_scanner.cpp \
+    ../src/binary_snapshot.cpp \
+    ../src/file_contact_repository.cpp
+
+HEADERS += \
+    ../include/contact.hpp \
+    ../include/phone_number.hpp \
+    ../include/text_scanner.hpp \
+    ../include/binary_snapshot.hpp \
+    ../include/contact_repository.hpp \
+    ../include/file_contact_repository.hpp
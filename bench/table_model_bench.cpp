@@ -0,0 +1,551 @@
+#include <QCoreApplication>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "contact.hpp"
+#include "contact_search_index.hpp"
+#include "contact_sort_keys.hpp"
+#include "contact_store.hpp"
+#include "contact_table_model.hpp"
+#include "live_rows.hpp"
+#include "phone_index.hpp"
+#include "phone_number.hpp"
+#include "search_key.hpp"
+#include "sorted_permutation.hpp"
+
+namespace
+{
+    constexpr int kContacts = 100000;
+    constexpr int kViewportRows = 40;
+    constexpr int kWheelStep = 3;
+    constexpr int kRounds = 3;
+    constexpr int kCheckContacts = 60000;
+
+    std::vector<Contact> sampleContacts()
+    {
+        std::vector<Contact> out;
+        out.reserve(kContacts);
+        for (int i = 0; i < kContacts; ++i)
+        {
+            Contact c;
+            c.setId(i + 1);
+            c.setFirstName("Konstantin");
+            c.setLastName(QString("Konstantinopolsky%1").arg(i));
+            c.setMiddleName("Aleksandrovich");
+            c.setEmail(QString("konstantin%1@example.com").arg(i));
+            c.setBirthDate(QDate(1950, 1, 1).addDays(i % 20000));
+            c.setPhoneNumbers({PhoneNumber(PhoneType::Home, "+7 (916) 123-45-67"),
+                               PhoneNumber(PhoneType::Work, "+7 (495) 765-43-21")});
+            out.push_back(std::move(c));
+        }
+        return out;
+    }
+
+    // What data() did before the per-row display cache: format on every call.
+    QVariant formatOnEveryCall(const ContactTableModel &model, int row, int col)
+    {
+        const ContactView c = model.contactAt(row);
+        switch (col)
+        {
+        case 0:
+            return c.lastName();
+        case 1:
+            return c.firstName();
+        case 2:
+            return c.middleName();
+        case 3:
+            return c.email();
+        case 4:
+        {
+            const QDate birthDate = c.birthDate();
+            return birthDate.isValid() ? birthDate.toString("dd.MM.yyyy") : QString();
+        }
+        case 5:
+        {
+            QStringList out;
+            for (const auto &p : c.phoneNumbers())
+                out.push_back(p.value());
+            return out.join(", ");
+        }
+        default:
+            return QVariant();
+        }
+    }
+
+    template <typename Cell>
+    quint64 scroll(int rows, int cols, Cell cell)
+    {
+        quint64 chars = 0;
+        for (int top = 0; top + kViewportRows <= rows; top += kWheelStep)
+        {
+            for (int row = top; row < top + kViewportRows; ++row)
+            {
+                for (int col = 0; col < cols; ++col)
+                    chars += static_cast<quint64>(cell(row, col).toString().size());
+            }
+        }
+        return chars;
+    }
+
+    template <typename Cell>
+    double run(const char *name, int rows, int cols, Cell cell, quint64 &chars)
+    {
+        const quint64 calls = static_cast<quint64>((rows - kViewportRows) / kWheelStep + 1) * kViewportRows * cols;
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int round = 0; round < kRounds; ++round)
+            chars = scroll(rows, cols, cell);
+        const qint64 nsecs = qMax<qint64>(1, timer.nsecsElapsed());
+
+        const double nsPerCall = static_cast<double>(nsecs) / static_cast<double>(calls * kRounds);
+        std::printf("%-10s %8.1f ns/data()  %8.1f ms/scroll\n", name, nsPerCall, nsecs / 1e6 / kRounds);
+        return nsPerCall;
+    }
+
+    bool mismatch(const char *what)
+    {
+        std::printf("MISMATCH: %s\n", what);
+        return false;
+    }
+
+    // LiveRows against a plain vector of live flags: rank() counts live
+    // positions before pos, select() is its inverse.
+    bool checkLiveRows()
+    {
+        QRandomGenerator random(7);
+        LiveRows rows;
+        std::vector<bool> live(1000, true);
+        rows.assign(static_cast<int>(live.size()));
+
+        for (int step = 0; step < 20000; ++step)
+        {
+            if (random.bounded(3) == 0)
+            {
+                rows.append();
+                live.push_back(true);
+            }
+            else
+            {
+                const int pos = static_cast<int>(random.bounded(static_cast<quint32>(live.size())));
+                if (live[static_cast<std::size_t>(pos)])
+                {
+                    rows.remove(pos);
+                    live[static_cast<std::size_t>(pos)] = false;
+                }
+            }
+
+            if (step % 100 != 0)
+                continue;
+
+            int rank = 0;
+            for (int pos = 0; pos < static_cast<int>(live.size()); ++pos)
+            {
+                if (rows.rank(pos) != rank)
+                    return mismatch("LiveRows::rank");
+                if (!live[static_cast<std::size_t>(pos)])
+                    continue;
+                if (rows.select(rank) != pos)
+                    return mismatch("LiveRows::select");
+                ++rank;
+            }
+            if (rows.size() != rank)
+                return mismatch("LiveRows::size");
+        }
+        return true;
+    }
+
+    std::vector<int> naiveOrder(const std::vector<QByteArray> &keys, const std::vector<bool> &member)
+    {
+        std::vector<int> rows;
+        for (int row = 0; row < static_cast<int>(keys.size()); ++row)
+        {
+            if (member[static_cast<std::size_t>(row)])
+                rows.push_back(row);
+        }
+        std::sort(rows.begin(), rows.end(), [&keys](int a, int b)
+                  {
+            const QByteArray &ka = keys[static_cast<std::size_t>(a)];
+            const QByteArray &kb = keys[static_cast<std::size_t>(b)];
+            return ka < kb || (ka == kb && a < b); });
+        return rows;
+    }
+
+    // SortedPermutation against std::sort of the member rows after random
+    // inserts, erases and key changes. Keys repeat on purpose to exercise ties.
+    bool checkSortedPermutation()
+    {
+        QRandomGenerator random(11);
+        const auto randomKey = [&random]
+        { return QByteArray::number(random.bounded(500)); };
+
+        std::vector<QByteArray> keys(2000);
+        std::vector<bool> member(keys.size());
+        for (std::size_t row = 0; row < keys.size(); ++row)
+        {
+            keys[row] = randomKey();
+            member[row] = (row % 2 == 0);
+        }
+
+        SortedPermutation perm;
+        perm.build(&keys, naiveOrder(keys, member));
+
+        for (int step = 0; step < 5000; ++step)
+        {
+            const int row = static_cast<int>(random.bounded(static_cast<quint32>(keys.size())));
+            switch (random.bounded(3))
+            {
+            case 0:
+                keys.push_back(randomKey());
+                member.push_back(true);
+                perm.insert(static_cast<int>(keys.size()) - 1);
+                break;
+            case 1:
+                if (member[static_cast<std::size_t>(row)])
+                    perm.erase(row);
+                else
+                    perm.insert(row);
+                member[static_cast<std::size_t>(row)] = !member[static_cast<std::size_t>(row)];
+                break;
+            default:
+                if (!member[static_cast<std::size_t>(row)])
+                    break;
+                perm.erase(row);
+                keys[static_cast<std::size_t>(row)] = randomKey();
+                perm.insert(row);
+                break;
+            }
+
+            if (step % 50 != 0)
+                continue;
+
+            const std::vector<int> expected = naiveOrder(keys, member);
+            if (perm.size() != static_cast<int>(expected.size()) || perm.inOrder() != expected)
+                return mismatch("SortedPermutation order");
+            for (int rank = 0; rank < static_cast<int>(expected.size()); ++rank)
+            {
+                if (perm.at(rank) != expected[static_cast<std::size_t>(rank)] ||
+                    perm.rankOf(expected[static_cast<std::size_t>(rank)]) != rank)
+                    return mismatch("SortedPermutation::at/rankOf");
+            }
+
+            const QByteArray probe = randomKey();
+            const int probeRow = static_cast<int>(random.bounded(static_cast<quint32>(keys.size())));
+            const auto less = std::count_if(expected.begin(), expected.end(), [&](int r)
+                                            {
+                const QByteArray &k = keys[static_cast<std::size_t>(r)];
+                return k < probe || (k == probe && r < probeRow); });
+            if (perm.countLess(probe, probeRow) != static_cast<int>(less))
+                return mismatch("SortedPermutation::countLess");
+        }
+        return true;
+    }
+
+    Contact checkContact(qint64 id, int variant)
+    {
+        const char *const firstNames[] = {"Семён", "Семен", "Semen", "Anna", "Ёлка", "Maria"};
+
+        Contact c;
+        c.setId(id);
+        c.setFirstName(QString::fromUtf8(firstNames[(id + variant) % 6]));
+        c.setLastName(QString("Name%1-%2").arg(id).arg(variant));
+        c.setMiddleName(id % 3 == 0 ? QString() : QString("Middle%1").arg(id % 50));
+        c.setAddress(QString("Street %1, %2").arg(id % 300).arg(variant));
+        c.setEmail(QString("user%1.%2@example.com").arg(id).arg(variant));
+        if (id % 7 != 0)
+            c.setBirthDate(QDate(1950, 1, 1).addDays((id * 37 + variant) % 20000));
+
+        std::vector<PhoneNumber> phones;
+        phones.emplace_back(PhoneType::Work, QString("+7 (9%1) %2").arg(id % 90 + 10).arg(1000000 + (id * 7919 + variant) % 9000000));
+        if (id % 4 == 0)
+            phones.emplace_back(PhoneType::Home, QString("8-495-%1").arg(1000000 + id % 9000000));
+        c.setPhoneNumbers(std::move(phones));
+        return c;
+    }
+
+    bool sameContact(const ContactView &view, const Contact &c)
+    {
+        if (view.id() != c.id() || view.firstName() != c.firstName() || view.lastName() != c.lastName() ||
+            view.middleName() != c.middleName() || view.address() != c.address() ||
+            view.birthDate() != c.birthDate() || view.email() != c.email())
+            return false;
+
+        const std::vector<PhoneNumber> phones = view.phoneNumbers();
+        if (phones.size() != c.phoneNumbers().size())
+            return false;
+        for (std::size_t i = 0; i < phones.size(); ++i)
+        {
+            if (phones[i].type() != c.phoneNumbers()[i].type() || phones[i].value() != c.phoneNumbers()[i].value())
+                return false;
+        }
+        return true;
+    }
+
+    struct Mirror
+    {
+        std::vector<qint64> order;
+        QHash<qint64, Contact> byId;
+
+        std::vector<Contact> contacts() const
+        {
+            std::vector<Contact> out;
+            out.reserve(order.size());
+            for (const qint64 id : order)
+                out.push_back(byId.value(id));
+            return out;
+        }
+
+        void removeIf(const std::function<bool(qint64)> &drop)
+        {
+            std::vector<qint64> kept;
+            for (const qint64 id : order)
+            {
+                if (drop(id))
+                    byId.remove(id);
+                else
+                    kept.push_back(id);
+            }
+            order = std::move(kept);
+        }
+    };
+
+    void sortAndWait(ContactTableModel &model, int column, Qt::SortOrder order)
+    {
+        QEventLoop loop;
+        bool changed = false;
+        const auto connection = QObject::connect(&model, &QAbstractItemModel::layoutChanged, [&]
+                                                 { changed = true; loop.quit(); });
+        model.sort(column, order);
+        if (!changed)
+            loop.exec();
+        QObject::disconnect(connection);
+    }
+
+    // Every row holds the mirror's contact, every contact shows once, and
+    // rows follow the column's sort key (or insertion order when unsorted).
+    bool checkRows(const ContactTableModel &model, const Mirror &mirror, int column, Qt::SortOrder order)
+    {
+        const int rows = model.rowCount();
+        if (rows != static_cast<int>(mirror.order.size()) || model.contactCount() != rows)
+            return mismatch("model row count");
+
+        const auto rowIds = model.rowIds();
+        if (static_cast<int>(rowIds->size()) != rows)
+            return mismatch("ContactTableModel::rowIds size");
+
+        QSet<qint64> seen;
+        QByteArray previous;
+        for (int row = 0; row < rows; ++row)
+        {
+            const ContactView view = model.contactAt(row);
+            const auto it = mirror.byId.constFind(view.id());
+            if (it == mirror.byId.constEnd() || seen.contains(view.id()) || !sameContact(view, it.value()))
+                return mismatch("model row content");
+            seen.insert(view.id());
+
+            if (model.rowOfId(view.id()) != row || (*rowIds)[static_cast<std::size_t>(row)] != view.id())
+                return mismatch("ContactTableModel::rowOfId/rowIds");
+
+            if (column < 0)
+            {
+                if (mirror.order[static_cast<std::size_t>(row)] != view.id())
+                    return mismatch("unsorted rows out of insertion order");
+                continue;
+            }
+
+            const QByteArray key = ContactSortKeys::key(view, column);
+            if (row > 0 && (order == Qt::AscendingOrder ? key < previous : previous < key))
+                return mismatch("rows out of sort order");
+            previous = key;
+        }
+        return true;
+    }
+
+    std::vector<qint64> naiveSearch(const QString &query, const std::vector<Contact> &contacts, bool phonesOnly)
+    {
+        const QByteArray q = ContactSearchIndex::normalizeQuery(query);
+        const bool phoneQuery = PhoneIndex::isPhoneQuery(query);
+        const QByteArray digits = PhoneNumber::canonicalDigits(query);
+
+        std::vector<qint64> out;
+        for (const Contact &c : contacts)
+        {
+            bool hit = !phonesOnly && SearchKey::forContact(c).contains(q);
+            for (std::size_t i = 0; phoneQuery && !hit && i < c.phoneNumbers().size(); ++i)
+            {
+                const QByteArray &d = c.phoneNumbers()[i].digits();
+                hit = d.startsWith(digits) || d.endsWith(digits) ||
+                      (digits.startsWith('8') && d.startsWith('7' + digits.mid(1))) ||
+                      (!digits.startsWith('7') && !digits.startsWith('8') && d.startsWith('7' + digits));
+            }
+            if (hit)
+                out.push_back(c.id());
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    bool checkSearch(const ContactTableModel &model, const Mirror &mirror)
+    {
+        const std::vector<Contact> contacts = mirror.contacts();
+        PhoneIndex phones;
+        phones.rebuild(contacts);
+
+        const QStringList queries = {"семен", "SEMEN", "ёлк", "an", "name12", "name123-1", "-0",
+                                     "street 42,", "example.com", "xyzzy", "916", "+7 (916) 10",
+                                     "8 (495) 100", "0-0", "4951000", "12 34", "9１6"};
+        for (const QString &query : queries)
+        {
+            std::vector<qint64> found = model.searchIndex().search(query);
+            std::sort(found.begin(), found.end());
+            if (found != naiveSearch(query, contacts, false))
+            {
+                std::printf("MISMATCH: search for \"%s\"\n", qPrintable(query));
+                return false;
+            }
+
+            if (phones.match(query) != naiveSearch(query, contacts, true))
+            {
+                std::printf("MISMATCH: phone match for \"%s\"\n", qPrintable(query));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Drives the model through removals (row compaction, string pool
+    // compaction), updates and inserts in and out of sorted mode, and checks
+    // rows and search hits against a plain mirror of the contacts.
+    bool checkModel()
+    {
+        QRandomGenerator random(23);
+        Mirror mirror;
+        std::vector<Contact> initial;
+        for (qint64 id = 1; id <= kCheckContacts; ++id)
+        {
+            initial.push_back(checkContact(id, 0));
+            mirror.order.push_back(id);
+            mirror.byId.insert(id, initial.back());
+        }
+
+        ContactTableModel model;
+        model.setContacts(std::move(initial));
+
+        mirror.removeIf([&](qint64 id)
+                        {
+            if (random.bounded(10) >= 6)
+                return false;
+            model.removeContact(id);
+            return true; });
+        if (!checkRows(model, mirror, -1, Qt::AscendingOrder) || !checkSearch(model, mirror))
+            return false;
+
+        sortAndWait(model, 0, Qt::AscendingOrder);
+        for (const qint64 id : std::vector<qint64>(mirror.order))
+        {
+            if (random.bounded(5) != 0)
+                continue;
+            const Contact changed = checkContact(id, 1 + static_cast<int>(random.bounded(1000)));
+            model.updateContact(changed);
+            mirror.byId[id] = changed;
+        }
+        mirror.removeIf([&](qint64 id)
+                        {
+            if (random.bounded(10) != 0)
+                return false;
+            model.removeContact(id);
+            return true; });
+
+        qint64 nextId = kCheckContacts + 1;
+        std::vector<Contact> batch;
+        for (int i = 0; i < 5000; ++i, ++nextId)
+        {
+            batch.push_back(checkContact(nextId, 0));
+            mirror.order.push_back(nextId);
+            mirror.byId.insert(nextId, batch.back());
+        }
+        model.insertContacts(std::move(batch));
+        for (int i = 0; i < 50; ++i, ++nextId)
+        {
+            model.insertContact(checkContact(nextId, 0));
+            mirror.order.push_back(nextId);
+            mirror.byId.insert(nextId, checkContact(nextId, 0));
+        }
+
+        if (!checkRows(model, mirror, 0, Qt::AscendingOrder))
+            return false;
+
+        sortAndWait(model, -1, Qt::AscendingOrder);
+        if (!checkRows(model, mirror, -1, Qt::AscendingOrder))
+            return false;
+
+        for (int column = 0; column < ContactSortKeys::kColumnCount; ++column)
+        {
+            for (const Qt::SortOrder order : {Qt::AscendingOrder, Qt::DescendingOrder})
+            {
+                sortAndWait(model, column, order);
+                if (!checkRows(model, mirror, column, order))
+                    return false;
+            }
+        }
+        return checkSearch(model, mirror);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    std::vector<Contact> contacts = sampleContacts();
+    std::size_t contactBytes = 0;
+    for (const Contact &c : contacts)
+        contactBytes += ContactStore::contactBytes(c);
+
+    ContactTableModel model;
+    model.setContacts(std::move(contacts));
+
+    const ContactStore::MemoryStats mem = model.memoryStats();
+    std::printf("memory: %zu -> %zu bytes/contact (%zu unique strings)\n", contactBytes / kContacts,
+                mem.bytes / qMax<std::size_t>(1, mem.contacts), mem.uniqueStrings);
+
+    const int rows = model.rowCount();
+    const int cols = model.columnCount();
+    std::printf("rows: %d, viewport: %d, wheel step: %d, %d rounds\n", rows, kViewportRows, kWheelStep, kRounds);
+
+    quint64 uncachedChars = 0;
+    quint64 cachedChars = 0;
+    const double uncached = run("uncached", rows, cols,
+                                [&model](int row, int col)
+                                { return formatOnEveryCall(model, row, col); },
+                                uncachedChars);
+    const double cached = run("data()", rows, cols,
+                              [&model](int row, int col)
+                              { return model.data(model.index(row, col), Qt::DisplayRole); },
+                              cachedChars);
+
+    if (uncachedChars != cachedChars)
+    {
+        std::printf("MISMATCH: cached and uncached cells differ\n");
+        return 1;
+    }
+
+    std::printf("speedup: %.2fx\n", uncached / cached);
+
+    if (!checkLiveRows() || !checkSortedPermutation() || !checkModel())
+        return 1;
+    std::printf("checks: LiveRows, SortedPermutation, model rows and search match the naive reference\n");
+    return 0;
+}
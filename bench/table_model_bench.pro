@@ -0,0 +1,33 @@
+TEMPLATE = app
+TARGET = table_model_bench
+CONFIG += c++17 console release
+CONFIG -= app_bundle
+QT = core sql concurrent
+
+INCLUDEPATH += $$PWD/../include
+DEPENDPATH  += $$PWD/../include
+
+SOURCES += \
+    table_model_bench.cpp \
+    ../src/contact.cpp \
+    ../src/phone_number.cpp \
+    ../src/phone_index.cpp \
+    ../src/search_key.cpp \
+    ../src/contact_search_index.cpp \
+    ../src/contact_sort_keys.cpp \
+    ../src/sorted_permutation.cpp \
+    ../src/live_rows.cpp \
+    ../src/contact_store.cpp \
+    ../src/contact_table_model.cpp
+
+HEADERS += \
+    ../include/contact.hpp \
+    ../include/phone_number.hpp \
+    ../include/phone_index.hpp \
+    ../include/search_key.hpp \
+    ../include/contact_search_index.hpp \
+    ../include/contact_sort_keys.hpp \
+    ../include/sorted_permutation.hpp \
+    ../include/live_rows.hpp \
+    ../include/contact_store.hpp \
+    ../include/contact_table_model.hpp
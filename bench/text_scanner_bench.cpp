@@ -0,0 +1,79 @@
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+#include <cstdio>
+#include <vector>
+
+#include "text_scanner.hpp"
+
+namespace
+{
+    constexpr int kContacts = 200000;
+    constexpr int kRounds = 10;
+
+    using Finder = const char *(*)(const char *, const char *);
+
+    QByteArray sampleText()
+    {
+        QByteArray out;
+        out.reserve(kContacts * 120);
+        for (int i = 0; i < kContacts; ++i)
+        {
+            out += "Konstantin|Konstantinopolsky|Aleksandrovich|Moscow, Tverskaya street 12-";
+            out += QByteArray::number(i);
+            out += "|01.02.1990|konstantin.konstantinopolsky";
+            out += QByteArray::number(i);
+            out += "@example.com|mobile:+7 (916) 123-45-67,work:+7 (495) 765-43-21|";
+            out += QByteArray::number(1000000 + i);
+            out += '\n';
+        }
+        return out;
+    }
+
+    quint64 countSpecials(Finder find, const char *begin, const char *end)
+    {
+        quint64 count = 0;
+        for (const char *p = find(begin, end); p < end; p = find(p + 1, end))
+            ++count;
+        return count;
+    }
+
+    double run(const char *name, Finder find, const QByteArray &data, quint64 &count)
+    {
+        const char *begin = data.constData();
+        const char *end = begin + data.size();
+
+        count = countSpecials(find, begin, end);
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int round = 0; round < kRounds; ++round)
+            count = countSpecials(find, begin, end);
+        const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+
+        const double mbPerSecond = (static_cast<double>(data.size()) * kRounds / (1024.0 * 1024.0)) / seconds;
+        std::printf("%-8s %10.1f MB/s  specials: %llu\n", name, mbPerSecond, static_cast<unsigned long long>(count));
+        return mbPerSecond;
+    }
+}
+
+int main()
+{
+    const QByteArray data = sampleText();
+    std::printf("input: %.1f MB, %d rounds\n", data.size() / (1024.0 * 1024.0), kRounds);
+
+    quint64 scalarCount = 0;
+    quint64 simdCount = 0;
+    const double scalar = run("scalar", findSpecialByteScalar, data, scalarCount);
+    const double simd = run("simd", findSpecialByte, data, simdCount);
+
+    if (scalarCount != simdCount)
+    {
+        std::printf("MISMATCH: scalar and simd found a different number of special bytes\n");
+        return 1;
+    }
+
+    std::printf("speedup: %.2fx\n", simd / scalar);
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = text_scanner_bench
+CONFIG += c++17 console release
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../include
+DEPENDPATH  += $$PWD/../include
+
+SOURCES += \
+    text_scanner_bench.cpp \
+    ../src/text_scanner.cpp
+
+HEADERS += \
+    ../include/text_scanner.hpp
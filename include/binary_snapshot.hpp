@@ -0,0 +1,9 @@
+#pragma once
+
+#include <QString>
+#include <vector>
+
+#include "contact.hpp"
+
+bool writeBinarySnapshot(const QString &path, const std::vector<Contact> &contacts, quint64 seq, QString *error = nullptr);
+bool readBinarySnapshot(const QString &path, std::vector<Contact> &contacts, quint64 &seq, QString *error = nullptr);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <functional>
+
+struct CircuitBreakerMetrics
+{
+    quint64 successes = 0;
+    quint64 failures = 0;
+    quint64 rejected = 0;
+    quint64 trips = 0;
+};
+
+class CircuitBreaker
+{
+public:
+    enum class State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    explicit CircuitBreaker(int failureThreshold = 3, int coolDownMs = 10 * 1000);
+
+    void configure(int failureThreshold, int coolDownMs);
+    void setStateListener(std::function<void(State)> listener);
+
+    bool allowRequest();
+    void recordSuccess();
+    void recordFailure();
+    void reset();
+
+    State state() const;
+    CircuitBreakerMetrics metrics() const;
+
+    static QString stateName(State state);
+
+private:
+    mutable QMutex mutex_;
+    int failureThreshold_;
+    int coolDownMs_;
+    State state_{State::Closed};
+    int consecutiveFailures_{0};
+    QElapsedTimer openedAt_;
+    CircuitBreakerMetrics metrics_;
+    std::function<void(State)> listener_;
+
+    bool transition(State next);
+    void notify(State state) const;
+};
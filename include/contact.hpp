@@ -9,6 +9,7 @@
 class Contact
 {
 public:
+    qint64 id() const;
     const QString &firstName() const;
     const QString &lastName() const;
     const QString &middleName() const;
@@ -17,6 +18,7 @@ public:
     const QString &email() const;
     const std::vector<PhoneNumber> &phoneNumbers() const;
 
+    void setId(qint64 value);
     void setFirstName(QString value);
     void setLastName(QString value);
     void setMiddleName(QString value);
@@ -25,7 +27,10 @@ public:
     void setEmail(QString value);
     void setPhoneNumbers(std::vector<PhoneNumber> values);
 
+    static qint64 generateId();
+
 private:
+    qint64 id_{0};
     QString firstName_;
     QString lastName_;
     QString middleName_;
@@ -34,3 +39,7 @@ private:
     QString email_;
     std::vector<PhoneNumber> phoneNumbers_;
 };
+
+quint64 contactFieldsDigest(const Contact &contact);
+quint64 phonesDigest(const std::vector<PhoneNumber> &phones);
+quint64 contactDigest(const Contact &contact);
@@ -1,10 +1,40 @@
 #pragma once
 
 #include <QString>
+#include <utility>
 #include <vector>
 
 #include "contact.hpp"
 
+struct ContactChange
+{
+    enum class Kind
+    {
+        Upsert,
+        Remove
+    };
+
+    Kind kind{Kind::Upsert};
+    qint64 id{0};
+    Contact contact;
+
+    static ContactChange upsert(Contact contact)
+    {
+        ContactChange change;
+        change.id = contact.id();
+        change.contact = std::move(contact);
+        return change;
+    }
+
+    static ContactChange remove(qint64 id)
+    {
+        ContactChange change;
+        change.kind = Kind::Remove;
+        change.id = id;
+        return change;
+    }
+};
+
 class ContactRepository
 {
 public:
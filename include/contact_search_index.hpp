@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "contact.hpp"
+#include "phone_index.hpp"
+
+class ContactSearchIndex
+{
+public:
+    void rebuild(const std::vector<Contact> &contacts);
+    void insert(const Contact &contact);
+    void update(const Contact &contact);
+    void remove(qint64 id);
+
+    std::vector<qint64> search(const QString &query, const std::atomic_bool *cancel = nullptr,
+                               quint64 *generation = nullptr) const;
+    std::vector<qint64> refine(const QString &query, const std::vector<qint64> &within,
+                               const std::atomic_bool *cancel = nullptr, quint64 *generation = nullptr) const;
+    int size() const;
+    quint64 generation() const;
+
+    static QByteArray normalizeQuery(const QString &query);
+
+private:
+    mutable QReadWriteLock lock_;
+
+    std::vector<qint64> ids_;
+    std::vector<QByteArray> keys_;
+    std::vector<quint32> freeSlots_;
+    QHash<qint64, quint32> slotOf_;
+    std::unordered_map<quint32, std::vector<quint32>> postings_;
+    PhoneIndex phones_;
+    quint64 generation_{0};
+
+    std::vector<qint64> searchKeyLocked(const QByteArray &q, const std::atomic_bool *cancel) const;
+    void insertLocked(const Contact &contact, bool indexPhones = true);
+    void removeLocked(qint64 id);
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "contact_search_index.hpp"
+
+class ContactSearchPipeline final : public QObject
+{
+    Q_OBJECT
+public:
+    using RowIdsSource = std::function<std::shared_ptr<const std::vector<qint64>>()>;
+
+    ContactSearchPipeline(const ContactSearchIndex &index, RowIdsSource rowIds, QObject *parent = nullptr);
+    ~ContactSearchPipeline() override;
+
+    void setDebounceMs(int ms);
+    void setQuery(const QString &query);
+    void refresh();
+    void cancel();
+
+signals:
+    void resultsReady(std::shared_ptr<const std::vector<int>> rows, std::shared_ptr<const std::vector<qint64>> rowIds);
+
+private:
+    struct Result
+    {
+        quint64 seq{0};
+        QString query;
+        quint64 generation{0};
+        std::shared_ptr<const std::vector<qint64>> hits;
+        std::shared_ptr<const std::vector<qint64>> rowIds;
+        std::shared_ptr<const std::vector<int>> rows;
+    };
+
+    const ContactSearchIndex &index_;
+    RowIdsSource rowIdsSource_;
+    QTimer debounce_;
+    QThreadPool pool_;
+    QFutureWatcher<Result> watcher_;
+
+    QString query_;
+    QByteArray key_;
+    quint64 seq_{0};
+    std::shared_ptr<std::atomic_bool> cancel_;
+
+    QByteArray lastKey_;
+    quint64 lastGeneration_{0};
+    std::shared_ptr<const std::vector<qint64>> lastHits_;
+
+    void run();
+    void onFinished();
+};
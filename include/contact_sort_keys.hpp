@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <Qt>
+#include <vector>
+
+#include "contact_store.hpp"
+
+class ContactSortKeys
+{
+public:
+    static constexpr int kColumnCount = 6;
+
+    static QByteArray key(const ContactView &contact, int column);
+    static QByteArray textKey(const QString &text);
+    static QByteArray dateKey(const QDate &date);
+
+    static std::vector<int> sortedRows(const std::vector<QByteArray> &keys, Qt::SortOrder order);
+};
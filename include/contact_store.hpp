@@ -0,0 +1,132 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDate>
+#include <QMultiHash>
+#include <QString>
+#include <vector>
+
+#include "contact.hpp"
+
+struct ContactId
+{
+    quint32 index{0xffffffffu};
+    quint32 generation{0};
+
+    bool isValid() const { return index != 0xffffffffu; }
+    bool operator==(const ContactId &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ContactId &other) const { return !(*this == other); }
+};
+
+class ContactStore;
+
+class ContactView
+{
+public:
+    ContactView() = default;
+    ContactView(const Contact &contact);
+    ContactView(const ContactStore *store, ContactId id);
+
+    bool isValid() const;
+
+    qint64 id() const;
+    QString firstName() const;
+    QString lastName() const;
+    QString middleName() const;
+    QString address() const;
+    QDate birthDate() const;
+    QString email() const;
+    std::vector<PhoneNumber> phoneNumbers() const;
+
+    Contact toContact() const;
+
+private:
+    const Contact *contact_{nullptr};
+    const ContactStore *store_{nullptr};
+    ContactId id_;
+};
+
+class ContactStore
+{
+public:
+    struct MemoryStats
+    {
+        std::size_t contacts{0};
+        std::size_t bytes{0};
+        std::size_t stringBytes{0};
+        std::size_t uniqueStrings{0};
+    };
+
+    void clear();
+    void reserve(std::size_t contacts);
+
+    ContactId add(const Contact &contact);
+    bool update(ContactId id, const Contact &contact);
+    bool remove(ContactId id);
+
+    bool contains(ContactId id) const;
+    ContactView view(ContactId id) const;
+    Contact materialize(ContactId id) const;
+    int size() const;
+
+    int slotCount() const;
+    quint32 nextSlot() const;
+    ContactId idAt(quint32 slot) const;
+
+    MemoryStats memoryStats() const;
+    static std::size_t contactBytes(const Contact &contact);
+
+private:
+    friend class ContactView;
+
+    class StringPool
+    {
+    public:
+        quint32 intern(const QString &text);
+        void release(quint32 handle);
+        QString text(quint32 handle) const;
+        std::size_t bytes() const;
+        std::size_t size() const;
+
+    private:
+        struct Entry
+        {
+            quint32 offset{0};
+            quint32 length{0};
+            quint32 refs{0};
+        };
+
+        QByteArray arena_;
+        std::vector<Entry> entries_;
+        std::vector<quint32> freeEntries_;
+        QMultiHash<uint, quint32> lookup_;
+        std::size_t garbage_{0};
+
+        void compact();
+    };
+
+    std::vector<qint64> ids_;
+    std::vector<quint32> generations_;
+    std::vector<quint32> firstNames_;
+    std::vector<quint32> lastNames_;
+    std::vector<quint32> middleNames_;
+    std::vector<quint32> addresses_;
+    std::vector<quint32> emails_;
+    std::vector<qint32> birthDays_;
+    std::vector<quint32> phoneBegin_;
+    std::vector<quint16> phoneCount_;
+    std::vector<quint8> live_;
+    std::vector<quint32> freeSlots_;
+    int size_{0};
+
+    std::vector<quint8> phoneTypes_;
+    std::vector<quint32> phoneValues_;
+    std::size_t phoneGarbage_{0};
+
+    StringPool strings_;
+
+    bool isLive(ContactId id) const;
+    void write(quint32 slot, const Contact &contact);
+    void releaseSlot(quint32 slot);
+    void compactPhones();
+};
@@ -1,18 +1,55 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QThreadPool>
+#include <array>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include "contact.hpp"
+#include "contact_search_index.hpp"
+#include "contact_store.hpp"
+#include "contact_sort_keys.hpp"
+#include "live_rows.hpp"
+#include "sorted_permutation.hpp"
+#include "db_contact_repository.hpp"
 
 class ContactTableModel final : public QAbstractTableModel
 {
     Q_OBJECT
 public:
     explicit ContactTableModel(QObject *parent = nullptr);
+    ~ContactTableModel() override;
 
-    void setContacts(const std::vector<Contact> &contacts);
-    const std::vector<Contact> &contacts() const;
+    void setContacts(std::vector<Contact> contacts);
+    std::vector<Contact> contacts() const;
+    int contactCount() const;
+    Contact contactById(qint64 id) const;
+    bool containsId(qint64 id) const;
+    ContactStore::MemoryStats memoryStats() const;
+    const ContactSearchIndex &searchIndex() const;
+
+    void insertContact(Contact contact);
+    void insertContacts(std::vector<Contact> contacts);
+    void updateContact(Contact contact);
+    void removeContact(qint64 contactId);
+
+    ContactView contactAt(int row) const;
+    int rowOfId(qint64 id) const;
+    std::shared_ptr<const std::vector<qint64>> rowIds() const;
+    bool rowIdsCurrent(const std::shared_ptr<const std::vector<qint64>> &ids) const;
+
+    void setPaged(const ContactQuery &query, int pageSize, int residentPages);
+    void setInMemory();
+    bool isPaged() const;
+    void setSearchTerm(const QString &term);
+    void reload();
+    void applyPage(quint64 token, int page, const ContactPage &result);
+    void pageFailed(quint64 token, int page);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -20,8 +57,86 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    void pageRequested(quint64 token, int page, const ContactQuery &query, const ContactCursor &after, int limit);
+    void pagesReset();
+
 private:
-    std::vector<Contact> contacts_;
+    struct DisplayCache
+    {
+        QString birthDate;
+        QString phones;
+        bool valid{false};
+    };
+
+    struct Page
+    {
+        ContactCursor after;
+        std::vector<Contact> rows;
+        std::vector<DisplayCache> display;
+        int size{0};
+        bool resident{false};
+        bool requested{false};
+    };
+
+    ContactStore store_;
+    std::vector<ContactId> rows_;
+    LiveRows liveRows_;
+    std::size_t tombstones_{0};
+    std::vector<int> posOfSlot_;
+    mutable std::vector<DisplayCache> display_;
+    QHash<qint64, quint32> slotById_;
+    ContactSearchIndex searchIndex_;
+    mutable std::shared_ptr<const std::vector<qint64>> rowIds_;
+
+    int sortColumn_{-1};
+    Qt::SortOrder sortOrder_{Qt::AscendingOrder};
+    int displayColumn_{-1};
+    Qt::SortOrder displayOrder_{Qt::AscendingOrder};
+    std::array<std::vector<QByteArray>, ContactSortKeys::kColumnCount> sortKeys_;
+    std::array<bool, ContactSortKeys::kColumnCount> sortKeysValid_{};
+    std::array<SortedPermutation, ContactSortKeys::kColumnCount> sortPerms_;
+    quint64 sortSeq_{0};
+    quint64 dataSeq_{0};
+    quint64 asyncSortSeq_{0};
+    quint64 asyncDataSeq_{0};
+    QThreadPool sortPool_;
+    QFutureWatcher<std::vector<int>> sortWatcher_;
+
+    bool paged_{false};
+    int pageSize_{200};
+    int residentPages_{10};
+    ContactQuery query_;
+    quint64 token_{0};
+    mutable std::vector<Page> pages_;
+    mutable std::deque<int> lru_;
+    int rowCount_{0};
+    ContactCursor next_;
+    bool hasMore_{false};
+    bool fetching_{false};
+
+    const DisplayCache &displayAt(int row, const ContactView &c) const;
+    int storageRow(int row) const;
+    int displayRowOf(int storage) const;
+    int displayRowFor(const QByteArray &key, int storage) const;
+    void appendContact(Contact contact);
+    void compactRows();
+    const std::vector<QByteArray> &ensureSortKeys(int column);
+    void updateSortKeys(int storage, int skipColumn = -1);
+    void invalidateSortKeys();
+    void sortInMemory(int column, Qt::SortOrder order);
+    void setDisplayOrder(int column, Qt::SortOrder order);
+    void onSortFinished();
+    void rebuildIndex(const std::vector<Contact> &contacts);
+    int pagedRowOfId(qint64 id) const;
+    void resetPages();
+    void requestPage(int page) const;
+    void touch(int page) const;
+    void evict() const;
 
-    static QString phonePreview(const Contact &c);
+    static QString phonePreview(const ContactView &c);
 };
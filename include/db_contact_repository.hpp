@@ -1,11 +1,36 @@
 #pragma once
 
+#include <QHash>
+#include <QMetaObject>
 #include <QSqlDatabase>
 #include <QString>
+#include <functional>
 #include <vector>
 
+#include "circuit_breaker.hpp"
 #include "contact_repository.hpp"
 
+struct ContactQuery
+{
+    QString term;
+    int sortColumn{0};
+    Qt::SortOrder order{Qt::AscendingOrder};
+};
+
+struct ContactCursor
+{
+    QString key;
+    qint64 id{0};
+    bool valid{false};
+};
+
+struct ContactPage
+{
+    std::vector<Contact> contacts;
+    ContactCursor next;
+    bool hasMore{false};
+};
+
 class DbContactRepository final : public ContactRepository
 {
 public:
@@ -17,11 +42,19 @@ public:
 
     bool initialize();
     bool isAvailable() const;
+    void disconnect();
 
     std::vector<Contact> loadAll() override;
+    bool loadBatched(int batchSize, const std::function<bool(std::vector<Contact> &&)> &sink);
+    ContactPage searchPage(const ContactQuery &query, const ContactCursor &after, int limit);
+    std::vector<Contact> fetchByIds(const std::vector<qint64> &ids);
+    bool subscribeToChanges(std::function<void(qint64)> handler);
     void saveAll(const std::vector<Contact> &contacts) override;
+    void applyChanges(const std::vector<ContactChange> &changes);
 
+    CircuitBreaker &circuitBreaker();
     QString lastError() const override;
+    bool lastErrorIsConnection() const;
 
     QString host() const;
     int port() const;
@@ -36,11 +69,29 @@ private:
     QString user_;
     QString password_;
 
+    struct RowDigest
+    {
+        quint64 fields{0};
+        quint64 phones{0};
+    };
+
     QString connectionName_;
     QString lastError_;
+    bool connectionError_{false};
     bool available_{false};
+    bool schemaReady_{false};
+    CircuitBreaker breaker_;
+
+    QHash<qint64, RowDigest> snapshot_;
+    bool snapshotValid_{false};
+
+    std::function<void(qint64)> changeHandler_;
+    QMetaObject::Connection notifyConnection_;
 
     QSqlDatabase db();
     bool open();
     bool ensureSchema();
+    bool backfillSearchKeys();
+    bool readRows(int batchSize, const std::function<bool(std::vector<Contact> &&)> &sink);
+    bool listen();
 };
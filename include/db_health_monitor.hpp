@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+#include "db_config.hpp"
+
+class QTimer;
+
+class DbHealthMonitor final : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DbHealthMonitor(DbConfig config, QObject *parent = nullptr);
+    ~DbHealthMonitor() override;
+
+    void setIntervals(int minBackoffMs, int maxBackoffMs, int onlineIntervalMs);
+
+    void start();
+    void stop();
+
+signals:
+    void healthChanged(bool online, const QString &message);
+
+private:
+    DbConfig config_;
+    QString connectionName_;
+
+    int minBackoffMs_{1000};
+    int maxBackoffMs_{60 * 1000};
+    int onlineIntervalMs_{15 * 1000};
+
+    QThread thread_;
+    QObject *context_{nullptr};
+    QTimer *timer_{nullptr};
+
+    bool online_{false};
+    int backoffMs_{0};
+
+    void probe();
+    void closeConnection();
+};
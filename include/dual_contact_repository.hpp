@@ -1,6 +1,9 @@
 #pragma once
 
+#include <QFuture>
+#include <QHash>
 #include <QString>
+#include <functional>
 #include <vector>
 
 #include "contact_repository.hpp"
@@ -10,62 +13,23 @@
 class DualContactRepository final : public ContactRepository
 {
 public:
-    DualContactRepository(DbContactRepository &db, FileContactRepository &file)
-        : db_(db), file_(file) {}
+    DualContactRepository(DbContactRepository &db, FileContactRepository &file);
 
-    std::vector<Contact> loadAll() override
-    {
-        lastError_.clear();
+    void setDbOnline(bool online);
+    bool dbOnline() const;
 
-        auto data = db_.loadAll();
-        const QString dbErr = db_.lastError().trimmed();
+    using BatchSink = std::function<void(const std::vector<Contact> &batch, bool first)>;
 
-        if (!dbErr.isEmpty())
-        {
-            lastError_ = "DB load failed: " + dbErr;
-            auto fallback = file_.loadAll();
-            const QString fileErr = file_.lastError().trimmed();
-            if (!fileErr.isEmpty())
-                lastError_ += " | File load failed: " + fileErr;
-            return fallback;
-        }
+    std::vector<Contact> loadAll() override;
+    std::vector<Contact> loadStreamed(const BatchSink &sink);
+    void saveAll(const std::vector<Contact> &contacts) override;
+    QFuture<QString> saveChanges(std::vector<ContactChange> changes);
+    QFuture<QString> applyRemote(std::vector<ContactChange> changes);
 
-        file_.saveAll(data);
-        const QString fileErr = file_.lastError().trimmed();
-        if (!fileErr.isEmpty())
-            lastError_ = "File sync after DB load failed: " + fileErr;
-
-        return data;
-    }
-
-    void saveAll(const std::vector<Contact> &contacts) override
-    {
-        lastError_.clear();
-
-        file_.saveAll(contacts);
-        const QString fileErr = file_.lastError().trimmed();
-
-        db_.saveAll(contacts);
-        const QString dbErr = db_.lastError().trimmed();
-
-        if (!fileErr.isEmpty() && !dbErr.isEmpty())
-        {
-            lastError_ = "File save failed: " + fileErr + " | DB save failed: " + dbErr;
-            return;
-        }
-
-        if (!fileErr.isEmpty())
-        {
-            lastError_ = "File save failed: " + fileErr;
-            return;
-        }
-
-        if (!dbErr.isEmpty())
-        {
-            lastError_ = "DB save failed: " + dbErr + " | saved to file";
-            return;
-        }
-    }
+    bool hasPendingSync() const;
+    bool syncPending();
+    std::size_t syncedChanges() const;
+    int retryDelayMs() const;
 
     QString lastError() const override { return lastError_; }
 
@@ -73,4 +37,14 @@ private:
     DbContactRepository &db_;
     FileContactRepository &file_;
     QString lastError_;
+
+    bool dbOnline_{false};
+
+    bool hasPending_{false};
+    int failedAttempts_{0};
+    std::size_t syncedChanges_{0};
+    QHash<qint64, int> changeFailures_;
+
+    std::vector<Contact> loadFile(const BatchSink &sink);
+    void rejectFailingChanges(const std::vector<ContactChange> &changes, quint64 upToSeq);
 };
@@ -1,17 +1,117 @@
 #pragma once
 
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QSet>
 #include <QString>
+#include <QThreadPool>
+
+#include <functional>
 
 #include "contact_repository.hpp"
 
+struct DurabilityMetrics
+{
+    quint64 commits = 0;
+    quint64 coalescedSaves = 0;
+    qint64 lastLatencyMs = 0;
+    qint64 maxLatencyMs = 0;
+    qint64 totalLatencyMs = 0;
+
+    double averageLatencyMs() const
+    {
+        return commits == 0 ? 0.0 : static_cast<double>(totalLatencyMs) / static_cast<double>(commits);
+    }
+};
+
 class FileContactRepository : public ContactRepository
 {
 public:
-    explicit FileContactRepository(QString filePath);
+    enum class Format
+    {
+        Text,
+        Binary
+    };
+
+    explicit FileContactRepository(QString filePath, Format format = Format::Text);
+    ~FileContactRepository() override;
+
+    void setJournaled(bool enabled);
+    void setCompactionThresholds(qint64 maxJournalBytes, double maxJournalRatio);
+    void setGroupCommitWindow(int ms);
 
     std::vector<Contact> loadAll() override;
     void saveAll(const std::vector<Contact> &contacts) override;
+    QFuture<QString> applyChanges(std::vector<ContactChange> changes, bool queueForDb = false);
+    void flush();
+
+    bool hasOutbox() const;
+    bool enqueueForDb(const std::vector<ContactChange> &changes);
+    std::vector<ContactChange> readOutbox(quint64 &upToSeq);
+    bool ackOutbox(quint64 upToSeq);
+    bool rejectOutbox(const QSet<qint64> &ids, quint64 upToSeq);
+    QString rejectedOutboxPath() const;
+
+    QString filePath() const;
+    QString lastError() const override;
+    DurabilityMetrics metrics() const;
 
 private:
     QString filePath_;
+    Format format_{Format::Text};
+
+    bool journaled_{false};
+    qint64 maxJournalBytes_{4 * 1024 * 1024};
+    double maxJournalRatio_{0.5};
+    int groupCommitWindowMs_{0};
+
+    mutable QMutex stateMutex_;
+    std::vector<quint64> digests_;
+    bool stateValid_{false};
+    bool digestsValid_{false};
+    bool unreadable_{false};
+    std::size_t contactCount_{0};
+    quint64 outboxSeq_{0};
+    bool outboxSeqKnown_{false};
+    quint64 seq_{0};
+    qint64 journalBytes_{0};
+    int journalRecords_{0};
+
+    mutable QMutex statusMutex_;
+    QString lastError_;
+    DurabilityMetrics metrics_;
+
+    QMutex pendingMutex_;
+    std::vector<ContactChange> pending_;
+    std::vector<ContactChange> pendingOutbox_;
+    std::vector<QFutureInterface<QString>> waiters_;
+    bool flushScheduled_{false};
+    quint64 pendingSaves_{0};
+    QElapsedTimer pendingSince_;
+
+    QThreadPool commitPool_;
+    QThreadPool ioPool_;
+    QFuture<void> compaction_;
+
+    QString journalPath() const;
+    QString rotatedJournalPath() const;
+    QString outboxPath() const;
+
+    std::vector<Contact> loadLocked(QString &error);
+
+    void flushPending();
+    QString commitChanges(const std::vector<ContactChange> &changes, const std::vector<ContactChange> &outbox,
+                          const QElapsedTimer &since, quint64 saves);
+    void recordCommit(bool ok, const QElapsedTimer &since, quint64 saves);
+    bool persist(const std::vector<Contact> &contacts, QString &error);
+    bool persistChanges(const std::vector<ContactChange> &changes, const std::vector<ContactChange> &outbox, QString &error);
+    bool writeChanges(const std::vector<ContactChange> &changes, QString &error);
+    bool appendOutbox(const std::vector<ContactChange> &changes, QString &error);
+    bool readOutboxLocked(std::vector<ContactChange> &changes, quint64 &lastSeq, QString &error);
+    bool rewriteOutbox(const std::function<bool(quint64 seq, qint64 id)> &drop, const QString &keepDroppedIn);
+    bool appendJournal(const std::vector<Contact> &contacts, std::vector<quint64> &digests);
+    bool writeFullSnapshot(const std::vector<Contact> &contacts, std::vector<quint64> digests, QString &error);
+    void maybeCompact();
 };
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+class LiveRows
+{
+public:
+    void clear();
+    void assign(int count);
+    void append();
+    void remove(int pos);
+
+    int size() const;
+    int rank(int pos) const;
+    int select(int rank) const;
+
+private:
+    std::vector<int> tree_;
+    int live_{0};
+
+    int prefix(int count) const;
+};
@@ -1,24 +1,28 @@
 #pragma once
 
 #include <QMainWindow>
+#include <memory>
 #include <vector>
 
 #include "contact.hpp"
-#include "contact_repository.hpp"
+#include "db_contact_repository.hpp"
 
 class QTableView;
 class QLineEdit;
 class QAction;
 class QCloseEvent;
 
+class ContactSearchPipeline;
 class ContactTableModel;
+class RepositoryWorker;
 class MultiFieldProxyModel;
 
 class MainWindow final : public QMainWindow
 {
     Q_OBJECT
 public:
-    explicit MainWindow(ContactRepository &repo);
+    explicit MainWindow(RepositoryWorker &worker);
+    ~MainWindow() override;
 
     void setDbStatus(bool online, const QString &message);
 
@@ -26,37 +30,58 @@ protected:
     void closeEvent(QCloseEvent *event) override;
 
 private:
-    ContactRepository &repo_;
-    std::vector<Contact> contacts_;
+    RepositoryWorker &worker_;
 
     QTableView *table_{nullptr};
     QLineEdit *search_{nullptr};
 
     ContactTableModel *model_{nullptr};
     MultiFieldProxyModel *proxy_{nullptr};
+    std::unique_ptr<ContactSearchPipeline> searchPipeline_;
 
     QAction *addAction_{nullptr};
     QAction *editAction_{nullptr};
     QAction *removeAction_{nullptr};
+    QAction *importAction_{nullptr};
 
     bool dbOnline_{false};
     QString dbMsg_;
+    QString breakerMsg_;
+
+    bool loading_{false};
+    QString saveMessage_;
 
     void buildUi();
     void buildMenu();
     void buildToolbar();
 
-    void refreshModel();
+    void setPagedMode(bool enabled);
+    void reloadPagedView();
     void updateStatusLine(const QString &extra);
 
-    int selectedSourceRow() const;
+    Contact selectedContact() const;
 
     void addContact();
     void editContact();
     void removeContact();
 
+    void setEditingEnabled(bool enabled);
+
     void loadFromStorage();
-    void saveToStorage();
+    void saveToStorage(std::vector<ContactChange> changes, const QString &doneMessage);
+    void onLoadBatch(const std::vector<Contact> &batch, bool first);
+    void onLoadFinished(const QString &error);
+    void onSaveFinished(const QString &error);
+    void onRemoteChanges(const std::vector<Contact> &changed, const std::vector<qint64> &removed);
+    void onPageFetched(quint64 token, int page, const ContactPage &result, const QString &error);
+
+    void onImportFinished(const std::vector<Contact> &imported, const QString &error);
+
+    void importText();
+    void exportText();
 
     void applySearch(const QString &text);
+    void applySearchResults(std::shared_ptr<const std::vector<int>> rows,
+                            const std::shared_ptr<const std::vector<qint64>> &rowIds);
+    void refreshSearch();
 };
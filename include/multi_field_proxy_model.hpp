@@ -1,12 +1,52 @@
 #pragma once
 
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
+#include <QList>
+#include <QPersistentModelIndex>
+#include <QVector>
+#include <memory>
+#include <vector>
 
-class MultiFieldProxyModel : public QSortFilterProxyModel
+class MultiFieldProxyModel : public QAbstractProxyModel
 {
 public:
     explicit MultiFieldProxyModel(QObject *parent = nullptr);
 
-protected:
-    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+    void setSourceModel(QAbstractItemModel *source) override;
+    void setAcceptedRows(std::shared_ptr<const std::vector<int>> rows);
+    bool isFiltered() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    QModelIndex sibling(int row, int column, const QModelIndex &idx) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private:
+    std::shared_ptr<const std::vector<int>> rows_;
+
+    QList<QMetaObject::Connection> connections_;
+    QModelIndexList layoutProxy_;
+    QList<QPersistentModelIndex> layoutSource_;
+    QList<QPersistentModelIndex> layoutAccepted_;
+    int removeFirst_{-1};
+    int removeLast_{-1};
+
+    int proxyLowerBound(int sourceRow) const;
+    void savePersistent();
+    void restorePersistent();
+
+    void onRowsInserted(int first, int last);
+    void onRowsAboutToBeRemoved(int first, int last);
+    void onRowsRemoved(int first, int last);
+    void onRowsAboutToBeMoved(int first, int last, int destination);
+    void onRowsMoved(int first, int last, int destination);
+    void onLayoutAboutToBeChanged();
+    void onLayoutChanged();
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <vector>
+
+#include "contact.hpp"
+#include "phone_number.hpp"
+
+class PhoneIndex
+{
+public:
+    void clear();
+    void rebuild(const std::vector<Contact> &contacts);
+    void insert(qint64 id, const std::vector<PhoneNumber> &phones);
+    void remove(qint64 id);
+
+    std::vector<qint64> match(const QString &query) const;
+
+    static bool isPhoneQuery(const QString &query);
+
+private:
+    struct Entry
+    {
+        QByteArray key;
+        qint64 id{0};
+
+        bool operator<(const Entry &other) const
+        {
+            return key < other.key || (key == other.key && id < other.id);
+        }
+    };
+
+    std::vector<Entry> byPrefix_;
+    std::vector<Entry> bySuffix_;
+    QHash<qint64, std::vector<QByteArray>> keysOf_;
+
+    static void insertEntry(std::vector<Entry> &entries, Entry entry);
+    static void removeEntry(std::vector<Entry> &entries, const Entry &entry);
+    static void collectPrefix(const std::vector<Entry> &entries, const QByteArray &prefix, std::vector<qint64> &out);
+    static QByteArray reversed(const QByteArray &key);
+};
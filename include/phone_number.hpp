@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QByteArray>
 #include <QString>
 
 enum class PhoneType
@@ -17,6 +18,7 @@ public:
 
     PhoneType type() const;
     const QString &value() const;
+    const QByteArray &digits() const;
 
     void setType(PhoneType type);
     void setValue(QString value);
@@ -27,7 +29,11 @@ public:
     static QString typeToLabel(PhoneType type);
     static PhoneType labelToType(const QString &label);
 
+    static QByteArray canonicalDigits(const QString &value);
+    static bool isDigit(QChar ch);
+
 private:
     PhoneType type_{PhoneType::Home};
     QString value_;
+    QByteArray digits_;
 };
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QList>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <vector>
+
+#include "contact.hpp"
+#include "db_contact_repository.hpp"
+#include "dual_contact_repository.hpp"
+#include "file_contact_repository.hpp"
+
+Q_DECLARE_METATYPE(std::vector<Contact>)
+Q_DECLARE_METATYPE(std::vector<qint64>)
+Q_DECLARE_METATYPE(ContactPage)
+
+class RepositoryWorker final : public QObject
+{
+    Q_OBJECT
+public:
+    RepositoryWorker(DbContactRepository &db, FileContactRepository &file, QObject *parent = nullptr);
+    ~RepositoryWorker() override;
+
+    void start();
+    void shutdown();
+
+    QFuture<bool> connectDb();
+    void setDbHealth(bool online, const QString &message);
+    QFuture<std::vector<Contact>> loadAll();
+    QFuture<QString> saveChanges(std::vector<ContactChange> changes);
+    void flush();
+    void importFrom(QString path);
+    void exportTo(QString path);
+    QFuture<ContactPage> fetchPage(quint64 token, int page, ContactQuery query, ContactCursor after, int limit);
+    void cancelPageFetches();
+
+    bool dbOnline() const;
+    bool dbConnecting() const;
+    QString dbStatusMessage() const;
+
+signals:
+    void loadBatch(const std::vector<Contact> &batch, bool first);
+    void loadFinished(const QString &error);
+    void saveFinished(const QString &error);
+    void importFinished(const std::vector<Contact> &imported, const QString &error);
+    void pendingSynced();
+    void pageFetched(quint64 token, int page, const ContactPage &result, const QString &error);
+    void dbStatusChanged(bool online, const QString &message);
+    void breakerChanged(const QString &state, quint64 trips);
+    void remoteChanges(const std::vector<Contact> &changed, const std::vector<qint64> &removed);
+
+private:
+    DbContactRepository &db_;
+    FileContactRepository &file_;
+    DualContactRepository dual_;
+
+    QThread thread_;
+    QObject *context_{nullptr};
+    QTimer *syncTimer_{nullptr};
+
+    mutable QMutex statusMutex_;
+    bool dbOnline_{false};
+    bool dbConnecting_{false};
+    QString dbMessage_;
+
+    QFuture<std::vector<Contact>> pendingLoad_;
+    QList<QFuture<ContactPage>> pendingPages_;
+
+    QSet<qint64> changedIds_;
+    bool changeFetchScheduled_{false};
+    int changeFetchFailures_{0};
+
+    void setDbStatus(bool online, const QString &message, bool connecting = false);
+    void commitChanges(std::vector<ContactChange> changes, QFutureInterface<QString> iface);
+    void scheduleSync(int delayMs);
+    void syncPending();
+    void onRemoteChange(qint64 id);
+    void scheduleChangeFetch(int delayMs);
+    void fetchRemoteChanges();
+
+    template <typename T, typename Fn>
+    QFuture<T> post(Fn fn);
+};
+
+template <typename T, typename Fn>
+QFuture<T> RepositoryWorker::post(Fn fn)
+{
+    QFutureInterface<T> iface;
+    iface.reportStarted();
+    QFuture<T> future = iface.future();
+
+    QMetaObject::invokeMethod(
+        context_, [iface, fn = std::move(fn)]() mutable
+        {
+            if (iface.isCanceled())
+            {
+                iface.reportFinished();
+                return;
+            }
+            const T result = fn();
+            iface.reportResult(result);
+            iface.reportFinished(); },
+        Qt::QueuedConnection);
+
+    return future;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+struct Migration
+{
+    int version;
+    QString description;
+    QStringList statements;
+    QStringList trigramStatements;
+};
+
+class SchemaMigrator
+{
+public:
+    explicit SchemaMigrator(QSqlDatabase database);
+
+    bool migrate();
+
+    int currentVersion() const;
+    QString lastError() const;
+
+    static const std::vector<Migration> &migrations();
+    static int latestVersion();
+
+private:
+    QSqlDatabase db_;
+    int currentVersion_{0};
+    QString lastError_;
+
+    bool readVersion(int &version);
+    bool trigramInstalled();
+    bool trigramIndexesMissing();
+    bool execAll(const QStringList &statements);
+    bool applyPending();
+    bool exec(const QString &sql, const char *what);
+};
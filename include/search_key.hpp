@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include "contact.hpp"
+
+class SearchKey
+{
+public:
+    static QByteArray normalize(const QString &text);
+    static QByteArray forContact(const Contact &contact);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <vector>
+
+class SortedPermutation
+{
+public:
+    void build(const std::vector<QByteArray> *keys, const std::vector<int> &sortedRows);
+    void clear();
+    bool isBuilt() const;
+    int size() const;
+
+    void insert(int row);
+    void erase(int row);
+
+    int at(int rank) const;
+    std::vector<int> inOrder() const;
+    int rankOf(int row) const;
+    int countLess(const QByteArray &key, int row) const;
+
+private:
+    const std::vector<QByteArray> *keys_{nullptr};
+    std::vector<int> left_;
+    std::vector<int> right_;
+    std::vector<int> parent_;
+    std::vector<int> size_;
+    std::vector<quint32> priority_;
+    int root_{-1};
+    quint32 seed_{0x9e3779b9u};
+
+    quint32 nextPriority();
+    int sizeOf(int node) const;
+    bool less(int a, int b) const;
+    void pull(int node);
+    void split(int node, int pivot, int &lo, int &hi);
+    int merge(int lo, int hi);
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+struct FieldRange
+{
+    const char *begin{nullptr};
+    const char *end{nullptr};
+    bool escaped{false};
+};
+
+const char *findSpecialByte(const char *begin, const char *end);
+const char *findSpecialByteScalar(const char *begin, const char *end);
+const char *scanField(const char *begin, const char *end, char delimiter, FieldRange &field);
+
+QString decodeField(const FieldRange &field);
+void appendEscaped(QByteArray &out, const QString &value);
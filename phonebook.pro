@@ -10,26 +10,54 @@ SOURCES += \
     src/main.cpp \
     src/contact.cpp \
     src/phone_number.cpp \
+    src/phone_index.cpp \
     src/validation.cpp \
     src/file_contact_repository.cpp \
+    src/binary_snapshot.cpp \
+    src/text_scanner.cpp \
     src/db_contact_repository.cpp \
+    src/dual_contact_repository.cpp \
+    src/db_health_monitor.cpp \
+    src/circuit_breaker.cpp \
+    src/schema_migrator.cpp \
+    src/search_key.cpp \
+    src/contact_search_index.cpp \
+    src/contact_search_pipeline.cpp \
+    src/contact_sort_keys.cpp \
+    src/sorted_permutation.cpp \
+    src/live_rows.cpp \
+    src/contact_store.cpp \
     src/contact_table_model.cpp \
     src/multi_field_proxy_model.cpp \
     src/contact_dialog.cpp \
     src/main_window.cpp \
+    src/repository_worker.cpp \
 
 
 HEADERS += \
     include/contact.hpp \
     include/phone_number.hpp \
+    include/phone_index.hpp \
     include/validation.hpp \
     include/contact_repository.hpp \
     include/file_contact_repository.hpp \
+    include/binary_snapshot.hpp \
+    include/text_scanner.hpp \
     include/db_contact_repository.hpp \
+    include/schema_migrator.hpp \
+    include/search_key.hpp \
+    include/contact_search_index.hpp \
+    include/contact_search_pipeline.hpp \
+    include/contact_sort_keys.hpp \
+    include/sorted_permutation.hpp \
+    include/live_rows.hpp \
+    include/contact_store.hpp \
     include/contact_table_model.hpp \
     include/multi_field_proxy_model.hpp \
     include/contact_dialog.hpp \
     include/main_window.hpp \
     include/db_config.hpp \
-    include/db_config.hpp \
-    dual_contact_repository.hpp
+    include/dual_contact_repository.hpp \
+    include/db_health_monitor.hpp \
+    include/circuit_breaker.hpp \
+    include/repository_worker.hpp
@@ -0,0 +1,361 @@
+#include "binary_snapshot.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // Layout (little-endian): fixed header, then one 8-byte aligned block per
+    // column. Strings live in a deduplicated UTF-16 pool and columns refer to
+    // them by index, so loading is a bounds check plus one memcpy per string.
+    constexpr char kMagic[4] = {'P', 'B', 'K', '1'};
+    constexpr quint16 kVersion = 2;
+    constexpr qint64 kNoDate = std::numeric_limits<qint64>::min();
+
+    enum Column
+    {
+        FirstNameColumn,
+        LastNameColumn,
+        MiddleNameColumn,
+        AddressColumn,
+        EmailColumn,
+        BirthDateColumn,
+        PhoneBeginColumn,
+        PhoneTypeColumn,
+        PhoneValueColumn,
+        StringOffsetColumn,
+        StringDataColumn,
+        IdColumn,
+        ColumnCount
+    };
+
+    constexpr int kVersion1ColumnCount = IdColumn;
+
+    constexpr int headerSize(int columnCount)
+    {
+        return 32 + 16 * columnCount;
+    }
+
+    template <typename T>
+    void appendLE(QByteArray &out, T value)
+    {
+        char buf[sizeof(T)];
+        qToLittleEndian(value, buf);
+        out.append(buf, static_cast<int>(sizeof(T)));
+    }
+
+    template <typename T>
+    QByteArray columnBytes(const std::vector<T> &values)
+    {
+        QByteArray out;
+        out.reserve(static_cast<int>(values.size() * sizeof(T)));
+        for (const T v : values)
+            appendLE(out, v);
+        return out;
+    }
+
+    template <typename T>
+    T readLE(const char *p)
+    {
+        return qFromLittleEndian<T>(p);
+    }
+
+    class StringPool
+    {
+    public:
+        StringPool() { offsets_.push_back(0); }
+
+        quint32 intern(const QString &value)
+        {
+            const auto it = ids_.constFind(value);
+            if (it != ids_.constEnd())
+                return *it;
+
+            const quint32 id = static_cast<quint32>(offsets_.size() - 1);
+            ids_.insert(value, id);
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+            for (const QChar ch : value)
+                appendLE(data_, ch.unicode());
+#else
+            data_.append(reinterpret_cast<const char *>(value.constData()), static_cast<int>(value.size() * 2));
+#endif
+            offsets_.push_back(static_cast<quint32>(data_.size() / 2));
+            return id;
+        }
+
+        const std::vector<quint32> &offsets() const { return offsets_; }
+        const QByteArray &data() const { return data_; }
+
+    private:
+        QHash<QString, quint32> ids_;
+        std::vector<quint32> offsets_;
+        QByteArray data_;
+    };
+
+    bool fail(QString *error, const QString &message)
+    {
+        if (error)
+            *error = message;
+        return false;
+    }
+}
+
+bool writeBinarySnapshot(const QString &path, const std::vector<Contact> &contacts, quint64 seq, QString *error)
+{
+    const std::size_t count = contacts.size();
+
+    StringPool pool;
+    std::vector<qint64> ids;
+    std::vector<quint32> firstNames, lastNames, middleNames, addresses, emails;
+    std::vector<qint64> birthDates;
+    std::vector<quint32> phoneBegin;
+    std::vector<quint8> phoneTypes;
+    std::vector<quint32> phoneValues;
+
+    ids.reserve(count);
+    firstNames.reserve(count);
+    lastNames.reserve(count);
+    middleNames.reserve(count);
+    addresses.reserve(count);
+    emails.reserve(count);
+    birthDates.reserve(count);
+    phoneBegin.reserve(count + 1);
+
+    for (const auto &c : contacts)
+    {
+        ids.push_back(c.id());
+        firstNames.push_back(pool.intern(c.firstName()));
+        lastNames.push_back(pool.intern(c.lastName()));
+        middleNames.push_back(pool.intern(c.middleName()));
+        addresses.push_back(pool.intern(c.address()));
+        emails.push_back(pool.intern(c.email()));
+        birthDates.push_back(c.birthDate().isValid() ? c.birthDate().toJulianDay() : kNoDate);
+
+        phoneBegin.push_back(static_cast<quint32>(phoneValues.size()));
+        for (const auto &p : c.phoneNumbers())
+        {
+            phoneTypes.push_back(static_cast<quint8>(p.type()));
+            phoneValues.push_back(pool.intern(p.value()));
+        }
+    }
+    phoneBegin.push_back(static_cast<quint32>(phoneValues.size()));
+
+    QByteArray columns[ColumnCount];
+    columns[FirstNameColumn] = columnBytes(firstNames);
+    columns[LastNameColumn] = columnBytes(lastNames);
+    columns[MiddleNameColumn] = columnBytes(middleNames);
+    columns[AddressColumn] = columnBytes(addresses);
+    columns[EmailColumn] = columnBytes(emails);
+    columns[BirthDateColumn] = columnBytes(birthDates);
+    columns[PhoneBeginColumn] = columnBytes(phoneBegin);
+    columns[PhoneTypeColumn] = columnBytes(phoneTypes);
+    columns[PhoneValueColumn] = columnBytes(phoneValues);
+    columns[StringOffsetColumn] = columnBytes(pool.offsets());
+    columns[StringDataColumn] = pool.data();
+    columns[IdColumn] = columnBytes(ids);
+
+    quint64 offsets[ColumnCount];
+    quint64 pos = headerSize(ColumnCount);
+    for (int i = 0; i < ColumnCount; ++i)
+    {
+        pos = (pos + 7) & ~quint64(7);
+        offsets[i] = pos;
+        pos += static_cast<quint64>(columns[i].size());
+    }
+
+    QByteArray header;
+    header.reserve(headerSize(ColumnCount));
+    header.append(kMagic, 4);
+    appendLE<quint16>(header, kVersion);
+    appendLE<quint16>(header, ColumnCount);
+    appendLE<quint32>(header, static_cast<quint32>(count));
+    appendLE<quint32>(header, static_cast<quint32>(phoneValues.size()));
+    appendLE<quint32>(header, static_cast<quint32>(pool.offsets().size() - 1));
+    appendLE<quint32>(header, 0);
+    appendLE<quint64>(header, seq);
+    for (int i = 0; i < ColumnCount; ++i)
+    {
+        appendLE<quint64>(header, offsets[i]);
+        appendLE<quint64>(header, static_cast<quint64>(columns[i].size()));
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, file.errorString());
+
+    file.write(header);
+    qint64 written = header.size();
+    for (int i = 0; i < ColumnCount; ++i)
+    {
+        const qint64 padding = static_cast<qint64>(offsets[i]) - written;
+        if (padding > 0)
+            file.write(QByteArray(static_cast<int>(padding), '\0'));
+        file.write(columns[i]);
+        written = static_cast<qint64>(offsets[i]) + columns[i].size();
+    }
+
+    if (!file.commit())
+        return fail(error, file.errorString());
+
+    return true;
+}
+
+bool readBinarySnapshot(const QString &path, std::vector<Contact> &contacts, quint64 &seq, QString *error)
+{
+    contacts.clear();
+    seq = 0;
+
+    QFile file(path);
+    if (!file.exists())
+        return true;
+
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(error, file.errorString());
+
+    const qint64 size = file.size();
+    if (size == 0)
+        return true;
+
+    QByteArray buffer;
+    const char *base = nullptr;
+    uchar *mapped = file.map(0, size);
+    if (mapped)
+    {
+        base = reinterpret_cast<const char *>(mapped);
+    }
+    else
+    {
+        buffer = file.readAll();
+        base = buffer.constData();
+    }
+
+    if (size < headerSize(kVersion1ColumnCount) || std::memcmp(base, kMagic, 4) != 0)
+        return fail(error, "not a phonebook snapshot: " + path);
+
+    const quint16 version = readLE<quint16>(base + 4);
+    const quint16 columnCount = readLE<quint16>(base + 6);
+    const bool known = (version == 1 && columnCount == kVersion1ColumnCount) ||
+                       (version == kVersion && columnCount == ColumnCount);
+    if (!known || size < headerSize(columnCount))
+        return fail(error, QString("unsupported snapshot version %1").arg(version));
+
+    const quint32 count = readLE<quint32>(base + 8);
+    const quint32 phoneCount = readLE<quint32>(base + 12);
+    const quint32 stringCount = readLE<quint32>(base + 16);
+    seq = readLE<quint64>(base + 24);
+
+    const char *column[ColumnCount] = {};
+    quint64 columnSize[ColumnCount] = {};
+    for (int i = 0; i < columnCount; ++i)
+    {
+        const quint64 offset = readLE<quint64>(base + 32 + 16 * i);
+        columnSize[i] = readLE<quint64>(base + 40 + 16 * i);
+        if (offset > static_cast<quint64>(size) || columnSize[i] > static_cast<quint64>(size) - offset)
+            return fail(error, "snapshot column out of bounds: " + path);
+        column[i] = base + offset;
+    }
+
+    const quint64 n = count;
+    const bool sizesOk =
+        columnSize[FirstNameColumn] == n * 4 && columnSize[LastNameColumn] == n * 4 &&
+        columnSize[MiddleNameColumn] == n * 4 && columnSize[AddressColumn] == n * 4 &&
+        columnSize[EmailColumn] == n * 4 && columnSize[BirthDateColumn] == n * 8 &&
+        columnSize[PhoneBeginColumn] == (n + 1) * 4 &&
+        columnSize[PhoneTypeColumn] == quint64(phoneCount) && columnSize[PhoneValueColumn] == quint64(phoneCount) * 4 &&
+        columnSize[StringOffsetColumn] == (quint64(stringCount) + 1) * 4 &&
+        (columnCount < ColumnCount || columnSize[IdColumn] == n * 8);
+    if (!sizesOk)
+        return fail(error, "snapshot column sizes do not match header: " + path);
+
+    const quint64 stringUnits = columnSize[StringDataColumn] / 2;
+    const QChar *stringData = reinterpret_cast<const QChar *>(column[StringDataColumn]);
+
+    std::vector<QString> pool;
+    pool.reserve(stringCount);
+    quint32 prev = readLE<quint32>(column[StringOffsetColumn]);
+    for (quint32 i = 0; i < stringCount; ++i)
+    {
+        const quint32 next = readLE<quint32>(column[StringOffsetColumn] + 4 * (i + 1));
+        if (next < prev || next > stringUnits)
+            return fail(error, "snapshot string pool is corrupt: " + path);
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        QString s(static_cast<int>(next - prev), Qt::Uninitialized);
+        for (quint32 k = prev; k < next; ++k)
+            s[static_cast<int>(k - prev)] = QChar(readLE<quint16>(column[StringDataColumn] + 2 * k));
+        pool.push_back(std::move(s));
+#else
+        pool.emplace_back(stringData + prev, static_cast<int>(next - prev));
+#endif
+        prev = next;
+    }
+
+    const auto str = [&](int col, quint32 row, QString &out)
+    {
+        const quint32 id = readLE<quint32>(column[col] + 4 * row);
+        if (id >= stringCount)
+            return false;
+        out = pool[id];
+        return true;
+    };
+
+    contacts.reserve(count);
+    for (quint32 row = 0; row < count; ++row)
+    {
+        QString first, last, middle, address, email;
+        if (!str(FirstNameColumn, row, first) || !str(LastNameColumn, row, last) ||
+            !str(MiddleNameColumn, row, middle) || !str(AddressColumn, row, address) ||
+            !str(EmailColumn, row, email))
+        {
+            contacts.clear();
+            return fail(error, "snapshot string reference out of range: " + path);
+        }
+
+        const quint32 phoneBegin = readLE<quint32>(column[PhoneBeginColumn] + 4 * row);
+        const quint32 phoneEnd = readLE<quint32>(column[PhoneBeginColumn] + 4 * (row + 1));
+        if (phoneBegin > phoneEnd || phoneEnd > phoneCount)
+        {
+            contacts.clear();
+            return fail(error, "snapshot phone range out of bounds: " + path);
+        }
+
+        std::vector<PhoneNumber> phones;
+        phones.reserve(phoneEnd - phoneBegin);
+        for (quint32 p = phoneBegin; p < phoneEnd; ++p)
+        {
+            QString value;
+            if (!str(PhoneValueColumn, p, value))
+            {
+                contacts.clear();
+                return fail(error, "snapshot string reference out of range: " + path);
+            }
+            const auto type = static_cast<PhoneType>(static_cast<quint8>(column[PhoneTypeColumn][p]));
+            phones.emplace_back(type, std::move(value));
+        }
+
+        const qint64 jd = readLE<qint64>(column[BirthDateColumn] + 8 * row);
+
+        Contact c;
+        if (column[IdColumn])
+            c.setId(readLE<qint64>(column[IdColumn] + 8 * row));
+        c.setFirstName(std::move(first));
+        c.setLastName(std::move(last));
+        c.setMiddleName(std::move(middle));
+        c.setAddress(std::move(address));
+        c.setBirthDate(jd == kNoDate ? QDate() : QDate::fromJulianDay(jd));
+        c.setEmail(std::move(email));
+        c.setPhoneNumbers(std::move(phones));
+        contacts.push_back(std::move(c));
+    }
+
+    if (mapped)
+        file.unmap(mapped);
+
+    return true;
+}
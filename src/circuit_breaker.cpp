@@ -0,0 +1,143 @@
+#include "circuit_breaker.hpp"
+
+#include <QLoggingCategory>
+#include <QMutexLocker>
+
+Q_DECLARE_LOGGING_CATEGORY(logDb)
+
+CircuitBreaker::CircuitBreaker(int failureThreshold, int coolDownMs)
+    : failureThreshold_(qMax(1, failureThreshold)),
+      coolDownMs_(qMax(0, coolDownMs))
+{
+}
+
+void CircuitBreaker::configure(int failureThreshold, int coolDownMs)
+{
+    QMutexLocker lock(&mutex_);
+    failureThreshold_ = qMax(1, failureThreshold);
+    coolDownMs_ = qMax(0, coolDownMs);
+}
+
+void CircuitBreaker::setStateListener(std::function<void(State)> listener)
+{
+    QMutexLocker lock(&mutex_);
+    listener_ = std::move(listener);
+}
+
+bool CircuitBreaker::allowRequest()
+{
+    bool changed = false;
+    {
+        QMutexLocker lock(&mutex_);
+        if (state_ != State::Open)
+            return true;
+
+        if (!openedAt_.isValid() || openedAt_.elapsed() < coolDownMs_)
+        {
+            ++metrics_.rejected;
+            return false;
+        }
+
+        changed = transition(State::HalfOpen);
+    }
+
+    if (changed)
+        notify(State::HalfOpen);
+    return true;
+}
+
+void CircuitBreaker::recordSuccess()
+{
+    bool changed = false;
+    {
+        QMutexLocker lock(&mutex_);
+        ++metrics_.successes;
+        consecutiveFailures_ = 0;
+        changed = transition(State::Closed);
+    }
+
+    if (changed)
+        notify(State::Closed);
+}
+
+void CircuitBreaker::recordFailure()
+{
+    bool changed = false;
+    {
+        QMutexLocker lock(&mutex_);
+        ++metrics_.failures;
+        ++consecutiveFailures_;
+
+        if (state_ == State::HalfOpen || consecutiveFailures_ >= failureThreshold_)
+        {
+            openedAt_.start();
+            changed = transition(State::Open);
+            if (changed)
+                ++metrics_.trips;
+        }
+    }
+
+    if (changed)
+    {
+        qCWarning(logDb) << "DB circuit breaker opened";
+        notify(State::Open);
+    }
+}
+
+void CircuitBreaker::reset()
+{
+    bool changed = false;
+    {
+        QMutexLocker lock(&mutex_);
+        consecutiveFailures_ = 0;
+        changed = transition(State::Closed);
+    }
+
+    if (changed)
+        notify(State::Closed);
+}
+
+CircuitBreaker::State CircuitBreaker::state() const
+{
+    QMutexLocker lock(&mutex_);
+    return state_;
+}
+
+CircuitBreakerMetrics CircuitBreaker::metrics() const
+{
+    QMutexLocker lock(&mutex_);
+    return metrics_;
+}
+
+QString CircuitBreaker::stateName(State state)
+{
+    switch (state)
+    {
+    case State::Open:
+        return "open";
+    case State::HalfOpen:
+        return "half-open";
+    default:
+        return "closed";
+    }
+}
+
+bool CircuitBreaker::transition(State next)
+{
+    if (state_ == next)
+        return false;
+    state_ = next;
+    return true;
+}
+
+void CircuitBreaker::notify(State state) const
+{
+    std::function<void(State)> listener;
+    {
+        QMutexLocker lock(&mutex_);
+        listener = listener_;
+    }
+
+    if (listener)
+        listener(state);
+}
@@ -1,5 +1,27 @@
 #include "contact.hpp"
 
+#include <QHash>
+#include <QRandomGenerator>
+
+namespace
+{
+    quint64 combine(quint64 seed, quint64 value)
+    {
+        seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+
+    quint64 hashString(const QString &value, quint64 seed)
+    {
+        return combine(seed, qHash(value, 0) ^ (static_cast<quint64>(value.size()) << 32));
+    }
+}
+
+qint64 Contact::id() const
+{
+    return id_;
+}
+
 const QString &Contact::firstName() const
 {
     return firstName_;
@@ -35,6 +57,11 @@ const std::vector<PhoneNumber> &Contact::phoneNumbers() const
     return phoneNumbers_;
 }
 
+void Contact::setId(qint64 value)
+{
+    id_ = value;
+}
+
 void Contact::setFirstName(QString value)
 {
     firstName_ = std::move(value);
@@ -69,3 +96,40 @@ void Contact::setPhoneNumbers(std::vector<PhoneNumber> values)
 {
     phoneNumbers_ = std::move(values);
 }
+
+qint64 Contact::generateId()
+{
+    qint64 id = 0;
+    while (id == 0)
+        id = static_cast<qint64>(QRandomGenerator::system()->generate64() >> 1);
+    return id;
+}
+
+quint64 contactFieldsDigest(const Contact &contact)
+{
+    quint64 h = 0;
+    h = hashString(contact.firstName(), h);
+    h = hashString(contact.lastName(), h);
+    h = hashString(contact.middleName(), h);
+    h = hashString(contact.address(), h);
+    h = combine(h, static_cast<quint64>(contact.birthDate().toJulianDay()));
+    h = hashString(contact.email(), h);
+    return h;
+}
+
+quint64 phonesDigest(const std::vector<PhoneNumber> &phones)
+{
+    quint64 h = phones.size();
+    for (const auto &p : phones)
+    {
+        h = combine(h, static_cast<quint64>(p.type()));
+        h = hashString(p.value(), h);
+    }
+    return h;
+}
+
+quint64 contactDigest(const Contact &contact)
+{
+    const quint64 h = combine(contactFieldsDigest(contact), phonesDigest(contact.phoneNumbers()));
+    return combine(h, static_cast<quint64>(contact.id()));
+}
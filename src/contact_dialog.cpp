@@ -236,6 +236,7 @@ bool ContactDialog::validateAndBuild()
     }
 
     Contact c;
+    c.setId(contact_.id() != 0 ? contact_.id() : Contact::generateId());
     c.setFirstName(first);
     c.setLastName(last);
     c.setMiddleName(middle);
@@ -0,0 +1,268 @@
+#include "contact_search_index.hpp"
+
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#include "search_key.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr std::size_t kCancelCheckEvery = 4096;
+
+    inline bool canceled(const std::atomic_bool *cancel, std::size_t i)
+    {
+        return cancel && (i % kCancelCheckEvery) == 0 && cancel->load(std::memory_order_relaxed);
+    }
+
+    inline quint32 trigramAt(const QByteArray &key, int i)
+    {
+        return (static_cast<quint32>(static_cast<uchar>(key.at(i))) << 16) |
+               (static_cast<quint32>(static_cast<uchar>(key.at(i + 1))) << 8) |
+               static_cast<quint32>(static_cast<uchar>(key.at(i + 2)));
+    }
+
+    std::vector<quint32> trigramsOf(const QByteArray &key)
+    {
+        std::vector<quint32> grams;
+        if (key.size() < 3)
+            return grams;
+
+        grams.reserve(static_cast<std::size_t>(key.size() - 2));
+        for (int i = 0; i + 2 < key.size(); ++i)
+            grams.push_back(trigramAt(key, i));
+
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    std::vector<quint32> intersect(const std::vector<quint32> &a, const std::vector<quint32> &b)
+    {
+        std::vector<quint32> out;
+        out.reserve(std::min(a.size(), b.size()));
+
+        auto it = b.begin();
+        for (const quint32 slot : a)
+        {
+            it = std::lower_bound(it, b.end(), slot);
+            if (it == b.end())
+                break;
+            if (*it == slot)
+                out.push_back(slot);
+        }
+        return out;
+    }
+}
+
+QByteArray ContactSearchIndex::normalizeQuery(const QString &query)
+{
+    return SearchKey::normalize(query);
+}
+
+void ContactSearchIndex::rebuild(const std::vector<Contact> &contacts)
+{
+    QWriteLocker lock(&lock_);
+
+    ids_.clear();
+    keys_.clear();
+    freeSlots_.clear();
+    slotOf_.clear();
+    postings_.clear();
+    phones_.rebuild(contacts);
+    ++generation_;
+
+    ids_.reserve(contacts.size());
+    keys_.reserve(contacts.size());
+    slotOf_.reserve(static_cast<int>(contacts.size()));
+
+    for (const Contact &c : contacts)
+        insertLocked(c, false);
+}
+
+void ContactSearchIndex::insert(const Contact &contact)
+{
+    QWriteLocker lock(&lock_);
+    removeLocked(contact.id());
+    insertLocked(contact);
+    ++generation_;
+}
+
+void ContactSearchIndex::update(const Contact &contact)
+{
+    insert(contact);
+}
+
+void ContactSearchIndex::remove(qint64 id)
+{
+    QWriteLocker lock(&lock_);
+    removeLocked(id);
+    ++generation_;
+}
+
+int ContactSearchIndex::size() const
+{
+    QReadLocker lock(&lock_);
+    return slotOf_.size();
+}
+
+quint64 ContactSearchIndex::generation() const
+{
+    QReadLocker lock(&lock_);
+    return generation_;
+}
+
+std::vector<qint64> ContactSearchIndex::search(const QString &query, const std::atomic_bool *cancel,
+                                               quint64 *generation) const
+{
+    const QByteArray q = normalizeQuery(query);
+
+    QReadLocker lock(&lock_);
+    if (generation)
+        *generation = generation_;
+
+    std::vector<qint64> result = searchKeyLocked(q, cancel);
+    if (!PhoneIndex::isPhoneQuery(query) || (cancel && cancel->load()))
+        return result;
+
+    const std::vector<qint64> byPhone = phones_.match(query);
+    result.insert(result.end(), byPhone.begin(), byPhone.end());
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+std::vector<qint64> ContactSearchIndex::searchKeyLocked(const QByteArray &q, const std::atomic_bool *cancel) const
+{
+    std::vector<qint64> result;
+
+    if (q.size() < 3)
+    {
+        for (std::size_t slot = 0; slot < ids_.size(); ++slot)
+        {
+            if (canceled(cancel, slot))
+                return {};
+            if (!keys_[slot].isEmpty() && keys_[slot].contains(q))
+                result.push_back(ids_[slot]);
+        }
+        return result;
+    }
+
+    std::vector<const std::vector<quint32> *> lists;
+    for (const quint32 gram : trigramsOf(q))
+    {
+        const auto it = postings_.find(gram);
+        if (it == postings_.end())
+            return result;
+        lists.push_back(&it->second);
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const std::vector<quint32> *a, const std::vector<quint32> *b)
+              { return a->size() < b->size(); });
+
+    std::vector<quint32> candidates = *lists.front();
+    for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+    {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return {};
+        candidates = intersect(candidates, *lists[i]);
+    }
+
+    result.reserve(candidates.size());
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (canceled(cancel, i))
+            return {};
+        const quint32 slot = candidates[i];
+        if (keys_[slot].contains(q))
+            result.push_back(ids_[slot]);
+    }
+    return result;
+}
+
+std::vector<qint64> ContactSearchIndex::refine(const QString &query, const std::vector<qint64> &within,
+                                               const std::atomic_bool *cancel, quint64 *generation) const
+{
+    if (PhoneIndex::isPhoneQuery(query))
+        return search(query, cancel, generation);
+
+    const QByteArray q = normalizeQuery(query);
+
+    QReadLocker lock(&lock_);
+    if (generation)
+        *generation = generation_;
+
+    std::vector<qint64> result;
+    result.reserve(within.size());
+    for (std::size_t i = 0; i < within.size(); ++i)
+    {
+        if (canceled(cancel, i))
+            return {};
+
+        const auto it = slotOf_.constFind(within[i]);
+        if (it != slotOf_.constEnd() && keys_[it.value()].contains(q))
+            result.push_back(within[i]);
+    }
+    return result;
+}
+
+void ContactSearchIndex::insertLocked(const Contact &contact, bool indexPhones)
+{
+    quint32 slot = 0;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<quint32>(ids_.size());
+        ids_.push_back(0);
+        keys_.emplace_back();
+    }
+
+    ids_[slot] = contact.id();
+    keys_[slot] = SearchKey::forContact(contact);
+    slotOf_.insert(contact.id(), slot);
+    if (indexPhones)
+        phones_.insert(contact.id(), contact.phoneNumbers());
+
+    for (const quint32 gram : trigramsOf(keys_[slot]))
+    {
+        std::vector<quint32> &list = postings_[gram];
+        if (list.empty() || list.back() < slot)
+            list.push_back(slot);
+        else
+            list.insert(std::lower_bound(list.begin(), list.end(), slot), slot);
+    }
+}
+
+void ContactSearchIndex::removeLocked(qint64 id)
+{
+    const auto found = slotOf_.find(id);
+    if (found == slotOf_.end())
+        return;
+
+    const quint32 slot = found.value();
+    slotOf_.erase(found);
+    phones_.remove(id);
+
+    for (const quint32 gram : trigramsOf(keys_[slot]))
+    {
+        const auto it = postings_.find(gram);
+        if (it == postings_.end())
+            continue;
+
+        std::vector<quint32> &list = it->second;
+        const auto pos = std::lower_bound(list.begin(), list.end(), slot);
+        if (pos != list.end() && *pos == slot)
+            list.erase(pos);
+        if (list.empty())
+            postings_.erase(it);
+    }
+
+    ids_[slot] = 0;
+    keys_[slot].clear();
+    freeSlots_.push_back(slot);
+}
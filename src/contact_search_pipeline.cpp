@@ -0,0 +1,138 @@
+#include "contact_search_pipeline.hpp"
+
+#include <QtConcurrent/QtConcurrent>
+
+#include <utility>
+
+namespace
+{
+    constexpr int kDefaultDebounceMs = 150;
+}
+
+ContactSearchPipeline::ContactSearchPipeline(const ContactSearchIndex &index, RowIdsSource rowIds, QObject *parent)
+    : QObject(parent),
+      index_(index),
+      rowIdsSource_(std::move(rowIds))
+{
+    pool_.setMaxThreadCount(1);
+
+    debounce_.setSingleShot(true);
+    debounce_.setInterval(kDefaultDebounceMs);
+    connect(&debounce_, &QTimer::timeout, this, [this]
+            { run(); });
+    connect(&watcher_, &QFutureWatcher<Result>::finished, this, [this]
+            { onFinished(); });
+}
+
+ContactSearchPipeline::~ContactSearchPipeline()
+{
+    cancel();
+    pool_.waitForDone();
+}
+
+void ContactSearchPipeline::setDebounceMs(int ms)
+{
+    debounce_.setInterval(qMax(0, ms));
+}
+
+void ContactSearchPipeline::setQuery(const QString &query)
+{
+    const QByteArray key = ContactSearchIndex::normalizeQuery(query);
+    if (key == key_ && !key.isEmpty())
+        return;
+
+    query_ = query.trimmed();
+    key_ = key;
+
+    if (key_.isEmpty())
+    {
+        cancel();
+        lastKey_.clear();
+        lastHits_.reset();
+        emit resultsReady(nullptr, nullptr);
+        return;
+    }
+
+    debounce_.start();
+}
+
+void ContactSearchPipeline::refresh()
+{
+    if (key_.isEmpty())
+        return;
+
+    debounce_.stop();
+    run();
+}
+
+void ContactSearchPipeline::cancel()
+{
+    debounce_.stop();
+    ++seq_;
+    query_.clear();
+    key_.clear();
+    if (cancel_)
+        cancel_->store(true);
+    cancel_.reset();
+}
+
+void ContactSearchPipeline::run()
+{
+    if (cancel_)
+        cancel_->store(true);
+    cancel_ = std::make_shared<std::atomic_bool>(false);
+
+    std::shared_ptr<const std::vector<qint64>> within;
+    if (lastHits_ && !lastKey_.isEmpty() && key_.contains(lastKey_) &&
+        lastGeneration_ == index_.generation())
+        within = lastHits_;
+
+    const quint64 seq = ++seq_;
+    const QString query = query_;
+    const ContactSearchIndex *index = &index_;
+    std::shared_ptr<std::atomic_bool> flag = cancel_;
+    std::shared_ptr<const std::vector<qint64>> rowIds = rowIdsSource_();
+
+    watcher_.setFuture(QtConcurrent::run(&pool_, [index, seq, query, within, flag, rowIds]
+                                         {
+        Result r;
+        r.seq = seq;
+        r.query = query;
+        r.rowIds = rowIds;
+        r.hits = std::make_shared<const std::vector<qint64>>(
+            within ? index->refine(query, *within, flag.get(), &r.generation)
+                   : index->search(query, flag.get(), &r.generation));
+        if (flag->load())
+            return r;
+
+        QSet<qint64> ids;
+        ids.reserve(static_cast<int>(r.hits->size()));
+        for (const qint64 id : *r.hits)
+            ids.insert(id);
+
+        auto rows = std::make_shared<std::vector<int>>();
+        rows->reserve(r.hits->size());
+        for (std::size_t row = 0; row < rowIds->size(); ++row)
+        {
+            if ((row & 0xfff) == 0 && flag->load())
+                return r;
+            if (ids.contains((*rowIds)[row]))
+                rows->push_back(static_cast<int>(row));
+        }
+        r.rows = std::move(rows);
+        return r; }));
+}
+
+void ContactSearchPipeline::onFinished()
+{
+    const Result r = watcher_.result();
+    if (r.seq != seq_ || !r.rows)
+        return;
+
+    cancel_.reset();
+    lastKey_ = ContactSearchIndex::normalizeQuery(r.query);
+    lastGeneration_ = r.generation;
+    lastHits_ = r.hits;
+
+    emit resultsReady(r.rows, r.rowIds);
+}
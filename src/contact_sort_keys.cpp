@@ -0,0 +1,127 @@
+#include "contact_sort_keys.hpp"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+    constexpr std::size_t kParallelSortMin = 50000;
+
+    void appendUtf16BigEndian(QByteArray &out, const QString &text)
+    {
+        const int offset = out.size();
+        out.resize(offset + text.size() * 2);
+        char *dst = out.data() + offset;
+        for (const QChar ch : text)
+        {
+            *dst++ = static_cast<char>(ch.unicode() >> 8);
+            *dst++ = static_cast<char>(ch.unicode() & 0xff);
+        }
+    }
+}
+
+QByteArray ContactSortKeys::textKey(const QString &text)
+{
+    const QString folded = text.toCaseFolded();
+
+    QString primary = folded;
+    primary.replace(QChar(0x0451), QChar(0x0435));
+
+    QByteArray out;
+    out.reserve((primary.size() + folded.size() + 1) * 2);
+    appendUtf16BigEndian(out, primary);
+    out.append('\0');
+    out.append('\0');
+    appendUtf16BigEndian(out, folded);
+    return out;
+}
+
+QByteArray ContactSortKeys::dateKey(const QDate &date)
+{
+    const quint64 day = date.isValid() ? static_cast<quint64>(date.toJulianDay()) : 0;
+    QByteArray out(8, '\0');
+    qToBigEndian(day, out.data());
+    return out;
+}
+
+QByteArray ContactSortKeys::key(const ContactView &contact, int column)
+{
+    switch (column)
+    {
+    case 0:
+        return textKey(contact.lastName());
+    case 1:
+        return textKey(contact.firstName());
+    case 2:
+        return textKey(contact.middleName());
+    case 3:
+        return textKey(contact.email());
+    case 4:
+        return dateKey(contact.birthDate());
+    case 5:
+    {
+        QString phones;
+        for (const PhoneNumber &p : contact.phoneNumbers())
+        {
+            if (!phones.isEmpty())
+                phones += '\n';
+            phones += p.value();
+        }
+        return textKey(phones);
+    }
+    default:
+        return QByteArray();
+    }
+}
+
+std::vector<int> ContactSortKeys::sortedRows(const std::vector<QByteArray> &keys, Qt::SortOrder order)
+{
+    std::vector<int> rows(keys.size());
+    std::iota(rows.begin(), rows.end(), 0);
+
+    const auto less = [&keys, order](int a, int b)
+    {
+        return order == Qt::AscendingOrder ? keys[static_cast<std::size_t>(a)] < keys[static_cast<std::size_t>(b)]
+                                           : keys[static_cast<std::size_t>(b)] < keys[static_cast<std::size_t>(a)];
+    };
+
+    const std::size_t parts = static_cast<std::size_t>(qMax(1, QThread::idealThreadCount()));
+    if (rows.size() < kParallelSortMin || parts == 1)
+    {
+        std::stable_sort(rows.begin(), rows.end(), less);
+        return rows;
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for (std::size_t i = 0; i < parts; ++i)
+        runs.emplace_back(rows.size() * i / parts, rows.size() * (i + 1) / parts);
+
+    QtConcurrent::blockingMap(runs, [&rows, &less](const std::pair<std::size_t, std::size_t> &run)
+                              { std::stable_sort(rows.begin() + run.first, rows.begin() + run.second, less); });
+
+    while (runs.size() > 1)
+    {
+        std::vector<std::pair<std::size_t, std::size_t>> merged;
+        std::vector<std::pair<std::size_t, std::size_t>> pairs;
+        for (std::size_t i = 0; i + 1 < runs.size(); i += 2)
+        {
+            pairs.emplace_back(i, i + 1);
+            merged.emplace_back(runs[i].first, runs[i + 1].second);
+        }
+        if (runs.size() % 2 != 0)
+            merged.push_back(runs.back());
+
+        QtConcurrent::blockingMap(pairs, [&rows, &runs, &less](const std::pair<std::size_t, std::size_t> &p)
+                                  { std::inplace_merge(rows.begin() + runs[p.first].first, rows.begin() + runs[p.first].second,
+                                                       rows.begin() + runs[p.second].second, less); });
+
+        runs = std::move(merged);
+    }
+
+    return rows;
+}
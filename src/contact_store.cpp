@@ -0,0 +1,444 @@
+#include "contact_store.hpp"
+
+#include <QArrayData>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    constexpr qint32 kNoBirthDay = std::numeric_limits<qint32>::min();
+    constexpr quint16 kMaxPhones = std::numeric_limits<quint16>::max();
+    constexpr std::size_t kCompactMinBytes = 64 * 1024;
+    constexpr std::size_t kCompactMinPhones = 1024;
+    constexpr std::size_t kHashNodeBytes = 24;
+
+    std::size_t stringBytes(const QString &s)
+    {
+        return s.capacity() == 0 ? 0 : sizeof(QArrayData) + (static_cast<std::size_t>(s.capacity()) + 1) * sizeof(QChar);
+    }
+
+    std::size_t byteArrayBytes(const QByteArray &b)
+    {
+        return b.capacity() == 0 ? 0 : sizeof(QArrayData) + static_cast<std::size_t>(b.capacity()) + 1;
+    }
+
+    template <typename T>
+    std::size_t vectorBytes(const std::vector<T> &v)
+    {
+        return v.capacity() * sizeof(T);
+    }
+
+    uint hashBytes(const char *data, int length)
+    {
+        return static_cast<uint>(qHash(QByteArray::fromRawData(data, length)));
+    }
+}
+
+ContactView::ContactView(const Contact &contact)
+    : contact_(&contact)
+{
+}
+
+ContactView::ContactView(const ContactStore *store, ContactId id)
+    : store_(store), id_(id)
+{
+}
+
+bool ContactView::isValid() const
+{
+    return contact_ || (store_ && store_->contains(id_));
+}
+
+qint64 ContactView::id() const
+{
+    return contact_ ? contact_->id() : store_->ids_[id_.index];
+}
+
+QString ContactView::firstName() const
+{
+    return contact_ ? contact_->firstName() : store_->strings_.text(store_->firstNames_[id_.index]);
+}
+
+QString ContactView::lastName() const
+{
+    return contact_ ? contact_->lastName() : store_->strings_.text(store_->lastNames_[id_.index]);
+}
+
+QString ContactView::middleName() const
+{
+    return contact_ ? contact_->middleName() : store_->strings_.text(store_->middleNames_[id_.index]);
+}
+
+QString ContactView::address() const
+{
+    return contact_ ? contact_->address() : store_->strings_.text(store_->addresses_[id_.index]);
+}
+
+QDate ContactView::birthDate() const
+{
+    if (contact_)
+        return contact_->birthDate();
+
+    const qint32 day = store_->birthDays_[id_.index];
+    return day == kNoBirthDay ? QDate() : QDate::fromJulianDay(day);
+}
+
+QString ContactView::email() const
+{
+    return contact_ ? contact_->email() : store_->strings_.text(store_->emails_[id_.index]);
+}
+
+std::vector<PhoneNumber> ContactView::phoneNumbers() const
+{
+    if (contact_)
+        return contact_->phoneNumbers();
+
+    const std::size_t begin = store_->phoneBegin_[id_.index];
+    const std::size_t count = store_->phoneCount_[id_.index];
+
+    std::vector<PhoneNumber> phones;
+    phones.reserve(count);
+    for (std::size_t i = begin; i < begin + count; ++i)
+        phones.emplace_back(static_cast<PhoneType>(store_->phoneTypes_[i]), store_->strings_.text(store_->phoneValues_[i]));
+    return phones;
+}
+
+Contact ContactView::toContact() const
+{
+    if (contact_)
+        return *contact_;
+
+    Contact c;
+    c.setId(id());
+    c.setFirstName(firstName());
+    c.setLastName(lastName());
+    c.setMiddleName(middleName());
+    c.setAddress(address());
+    c.setBirthDate(birthDate());
+    c.setEmail(email());
+    c.setPhoneNumbers(phoneNumbers());
+    return c;
+}
+
+void ContactStore::clear()
+{
+    *this = ContactStore();
+}
+
+void ContactStore::reserve(std::size_t contacts)
+{
+    ids_.reserve(contacts);
+    generations_.reserve(contacts);
+    firstNames_.reserve(contacts);
+    lastNames_.reserve(contacts);
+    middleNames_.reserve(contacts);
+    addresses_.reserve(contacts);
+    emails_.reserve(contacts);
+    birthDays_.reserve(contacts);
+    phoneBegin_.reserve(contacts);
+    phoneCount_.reserve(contacts);
+    live_.reserve(contacts);
+}
+
+ContactId ContactStore::add(const Contact &contact)
+{
+    quint32 slot = 0;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<quint32>(ids_.size());
+        ids_.push_back(0);
+        generations_.push_back(0);
+        firstNames_.push_back(0);
+        lastNames_.push_back(0);
+        middleNames_.push_back(0);
+        addresses_.push_back(0);
+        emails_.push_back(0);
+        birthDays_.push_back(kNoBirthDay);
+        phoneBegin_.push_back(0);
+        phoneCount_.push_back(0);
+        live_.push_back(0);
+    }
+
+    live_[slot] = 1;
+    write(slot, contact);
+    ++size_;
+    return ContactId{slot, generations_[slot]};
+}
+
+bool ContactStore::update(ContactId id, const Contact &contact)
+{
+    if (!isLive(id))
+        return false;
+
+    releaseSlot(id.index);
+    write(id.index, contact);
+    return true;
+}
+
+bool ContactStore::remove(ContactId id)
+{
+    if (!isLive(id))
+        return false;
+
+    releaseSlot(id.index);
+    phoneGarbage_ += phoneCount_[id.index];
+    phoneCount_[id.index] = 0;
+    live_[id.index] = 0;
+    ++generations_[id.index];
+    freeSlots_.push_back(id.index);
+    --size_;
+
+    compactPhones();
+    return true;
+}
+
+bool ContactStore::contains(ContactId id) const
+{
+    return isLive(id);
+}
+
+ContactView ContactStore::view(ContactId id) const
+{
+    return ContactView(this, id);
+}
+
+Contact ContactStore::materialize(ContactId id) const
+{
+    return isLive(id) ? view(id).toContact() : Contact();
+}
+
+int ContactStore::size() const
+{
+    return size_;
+}
+
+int ContactStore::slotCount() const
+{
+    return static_cast<int>(ids_.size());
+}
+
+quint32 ContactStore::nextSlot() const
+{
+    return freeSlots_.empty() ? static_cast<quint32>(ids_.size()) : freeSlots_.back();
+}
+
+ContactId ContactStore::idAt(quint32 slot) const
+{
+    if (slot >= live_.size() || !live_[slot])
+        return ContactId{};
+    return ContactId{slot, generations_[slot]};
+}
+
+ContactStore::MemoryStats ContactStore::memoryStats() const
+{
+    MemoryStats stats;
+    stats.contacts = static_cast<std::size_t>(size_);
+    stats.stringBytes = strings_.bytes();
+    stats.uniqueStrings = strings_.size();
+    stats.bytes = vectorBytes(ids_) + vectorBytes(generations_) + vectorBytes(firstNames_) + vectorBytes(lastNames_) +
+                  vectorBytes(middleNames_) + vectorBytes(addresses_) + vectorBytes(emails_) + vectorBytes(birthDays_) +
+                  vectorBytes(phoneBegin_) + vectorBytes(phoneCount_) + vectorBytes(live_) + vectorBytes(freeSlots_) +
+                  vectorBytes(phoneTypes_) + vectorBytes(phoneValues_) + stats.stringBytes;
+    return stats;
+}
+
+std::size_t ContactStore::contactBytes(const Contact &contact)
+{
+    std::size_t bytes = sizeof(Contact);
+    bytes += stringBytes(contact.firstName());
+    bytes += stringBytes(contact.lastName());
+    bytes += stringBytes(contact.middleName());
+    bytes += stringBytes(contact.address());
+    bytes += stringBytes(contact.email());
+    bytes += vectorBytes(contact.phoneNumbers());
+    for (const PhoneNumber &p : contact.phoneNumbers())
+        bytes += stringBytes(p.value()) + byteArrayBytes(p.digits());
+    return bytes;
+}
+
+bool ContactStore::isLive(ContactId id) const
+{
+    return id.isValid() && id.index < live_.size() && live_[id.index] && generations_[id.index] == id.generation;
+}
+
+void ContactStore::write(quint32 slot, const Contact &contact)
+{
+    ids_[slot] = contact.id();
+    firstNames_[slot] = strings_.intern(contact.firstName());
+    lastNames_[slot] = strings_.intern(contact.lastName());
+    middleNames_[slot] = strings_.intern(contact.middleName());
+    addresses_[slot] = strings_.intern(contact.address());
+    emails_[slot] = strings_.intern(contact.email());
+    birthDays_[slot] = contact.birthDate().isValid() ? static_cast<qint32>(contact.birthDate().toJulianDay()) : kNoBirthDay;
+
+    const std::vector<PhoneNumber> &phones = contact.phoneNumbers();
+    const quint16 count = static_cast<quint16>(std::min<std::size_t>(phones.size(), kMaxPhones));
+
+    if (count > phoneCount_[slot])
+    {
+        phoneGarbage_ += phoneCount_[slot];
+        phoneBegin_[slot] = static_cast<quint32>(phoneTypes_.size());
+        phoneTypes_.resize(phoneTypes_.size() + count);
+        phoneValues_.resize(phoneValues_.size() + count);
+    }
+    else
+    {
+        phoneGarbage_ += phoneCount_[slot] - count;
+    }
+    phoneCount_[slot] = count;
+
+    const std::size_t begin = phoneBegin_[slot];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        phoneTypes_[begin + i] = static_cast<quint8>(phones[i].type());
+        phoneValues_[begin + i] = strings_.intern(phones[i].value());
+    }
+
+    compactPhones();
+}
+
+void ContactStore::releaseSlot(quint32 slot)
+{
+    strings_.release(firstNames_[slot]);
+    strings_.release(lastNames_[slot]);
+    strings_.release(middleNames_[slot]);
+    strings_.release(addresses_[slot]);
+    strings_.release(emails_[slot]);
+    firstNames_[slot] = lastNames_[slot] = middleNames_[slot] = addresses_[slot] = emails_[slot] = 0;
+
+    const std::size_t begin = phoneBegin_[slot];
+    for (std::size_t i = begin; i < begin + phoneCount_[slot]; ++i)
+    {
+        strings_.release(phoneValues_[i]);
+        phoneValues_[i] = 0;
+    }
+}
+
+void ContactStore::compactPhones()
+{
+    if (phoneGarbage_ < kCompactMinPhones || phoneGarbage_ * 2 < phoneTypes_.size())
+        return;
+
+    std::vector<quint8> types;
+    std::vector<quint32> values;
+    types.reserve(phoneTypes_.size() - phoneGarbage_);
+    values.reserve(phoneValues_.size() - phoneGarbage_);
+
+    for (std::size_t slot = 0; slot < live_.size(); ++slot)
+    {
+        if (!live_[slot])
+            continue;
+
+        const std::size_t begin = phoneBegin_[slot];
+        phoneBegin_[slot] = static_cast<quint32>(types.size());
+        types.insert(types.end(), phoneTypes_.begin() + static_cast<std::ptrdiff_t>(begin),
+                     phoneTypes_.begin() + static_cast<std::ptrdiff_t>(begin + phoneCount_[slot]));
+        values.insert(values.end(), phoneValues_.begin() + static_cast<std::ptrdiff_t>(begin),
+                      phoneValues_.begin() + static_cast<std::ptrdiff_t>(begin + phoneCount_[slot]));
+    }
+
+    phoneTypes_ = std::move(types);
+    phoneValues_ = std::move(values);
+    phoneGarbage_ = 0;
+}
+
+quint32 ContactStore::StringPool::intern(const QString &text)
+{
+    if (text.isEmpty())
+        return 0;
+
+    const QByteArray utf8 = text.toUtf8();
+    const uint hash = hashBytes(utf8.constData(), utf8.size());
+
+    for (auto it = lookup_.constFind(hash); it != lookup_.constEnd() && it.key() == hash; ++it)
+    {
+        Entry &e = entries_[it.value()];
+        if (e.length == static_cast<quint32>(utf8.size()) &&
+            std::memcmp(arena_.constData() + e.offset, utf8.constData(), e.length) == 0)
+        {
+            ++e.refs;
+            return it.value() + 1;
+        }
+    }
+
+    quint32 index = 0;
+    if (!freeEntries_.empty())
+    {
+        index = freeEntries_.back();
+        freeEntries_.pop_back();
+    }
+    else
+    {
+        index = static_cast<quint32>(entries_.size());
+        entries_.emplace_back();
+    }
+
+    entries_[index] = Entry{static_cast<quint32>(arena_.size()), static_cast<quint32>(utf8.size()), 1};
+    arena_.append(utf8);
+    lookup_.insert(hash, index);
+    return index + 1;
+}
+
+void ContactStore::StringPool::release(quint32 handle)
+{
+    if (handle == 0)
+        return;
+
+    const quint32 index = handle - 1;
+    Entry &e = entries_[index];
+    if (--e.refs > 0)
+        return;
+
+    lookup_.remove(hashBytes(arena_.constData() + e.offset, static_cast<int>(e.length)), index);
+    garbage_ += e.length;
+    freeEntries_.push_back(index);
+
+    if (garbage_ >= kCompactMinBytes && garbage_ * 2 >= static_cast<std::size_t>(arena_.size()))
+        compact();
+}
+
+QString ContactStore::StringPool::text(quint32 handle) const
+{
+    if (handle == 0)
+        return QString();
+
+    const Entry &e = entries_[handle - 1];
+    return QString::fromUtf8(arena_.constData() + e.offset, static_cast<int>(e.length));
+}
+
+std::size_t ContactStore::StringPool::bytes() const
+{
+    return static_cast<std::size_t>(arena_.capacity()) + vectorBytes(entries_) + vectorBytes(freeEntries_) +
+           static_cast<std::size_t>(lookup_.size()) * kHashNodeBytes;
+}
+
+std::size_t ContactStore::StringPool::size() const
+{
+    return entries_.size() - freeEntries_.size();
+}
+
+void ContactStore::StringPool::compact()
+{
+    QByteArray fresh;
+    fresh.reserve(arena_.size() - static_cast<int>(garbage_));
+
+    for (Entry &e : entries_)
+    {
+        if (e.refs == 0)
+            continue;
+
+        const quint32 offset = static_cast<quint32>(fresh.size());
+        fresh.append(arena_.constData() + e.offset, static_cast<int>(e.length));
+        e.offset = offset;
+    }
+
+    arena_ = std::move(fresh);
+    garbage_ = 0;
+}
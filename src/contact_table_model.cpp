@@ -1,29 +1,429 @@
 #include "contact_table_model.hpp"
 
 #include <QString>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    constexpr std::size_t kAsyncSortRows = 20000;
+    constexpr std::size_t kIncrementalInsertMax = 64;
+    constexpr std::size_t kSortKeyChunk = 4096;
+    constexpr std::size_t kCompactRowsMin = 1024;
+
+    std::vector<int> liveSortedRows(const std::vector<QByteArray> &keys)
+    {
+        std::vector<int> rows = ContactSortKeys::sortedRows(keys, Qt::AscendingOrder);
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [&keys](int slot)
+                                  { return keys[static_cast<std::size_t>(slot)].isEmpty(); }),
+                   rows.end());
+        return rows;
+    }
+}
 
 ContactTableModel::ContactTableModel(QObject *parent)
     : QAbstractTableModel(parent)
 {
+    sortPool_.setMaxThreadCount(1);
+    connect(&sortWatcher_, &QFutureWatcher<std::vector<int>>::finished, this, [this]
+            { onSortFinished(); });
+
+    const auto dropRowIds = [this]
+    { rowIds_.reset(); };
+    connect(this, &QAbstractItemModel::rowsInserted, this, dropRowIds);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, dropRowIds);
+    connect(this, &QAbstractItemModel::rowsMoved, this, dropRowIds);
+    connect(this, &QAbstractItemModel::layoutChanged, this, dropRowIds);
+    connect(this, &QAbstractItemModel::modelReset, this, dropRowIds);
+}
+
+ContactTableModel::~ContactTableModel()
+{
+    sortPool_.waitForDone();
+}
+
+void ContactTableModel::setContacts(std::vector<Contact> contacts)
+{
+    ++dataSeq_;
+
+    if (paged_)
+        return;
+
+    beginResetModel();
+    rebuildIndex(contacts);
+    invalidateSortKeys();
+    displayColumn_ = -1;
+    endResetModel();
+
+    if (sortColumn_ >= 0)
+        sortInMemory(sortColumn_, sortOrder_);
+}
+
+std::vector<Contact> ContactTableModel::contacts() const
+{
+    std::vector<Contact> out;
+    out.reserve(static_cast<std::size_t>(store_.size()));
+    for (const ContactId id : rows_)
+    {
+        if (id.isValid())
+            out.push_back(store_.materialize(id));
+    }
+    return out;
+}
+
+int ContactTableModel::contactCount() const
+{
+    return paged_ ? rowCount_ : store_.size();
+}
+
+Contact ContactTableModel::contactById(qint64 id) const
+{
+    const auto it = slotById_.constFind(id);
+    if (it == slotById_.constEnd())
+        return Contact();
+    return store_.materialize(store_.idAt(it.value()));
+}
+
+bool ContactTableModel::containsId(qint64 id) const
+{
+    return slotById_.contains(id);
+}
+
+ContactStore::MemoryStats ContactTableModel::memoryStats() const
+{
+    return store_.memoryStats();
+}
+
+const ContactSearchIndex &ContactTableModel::searchIndex() const
+{
+    return searchIndex_;
+}
+
+void ContactTableModel::insertContact(Contact contact)
+{
+    std::vector<Contact> one;
+    one.push_back(std::move(contact));
+    insertContacts(std::move(one));
+}
+
+void ContactTableModel::insertContacts(std::vector<Contact> contacts)
+{
+    if (contacts.empty() || paged_)
+        return;
+
+    ++dataSeq_;
+    const bool sorted = displayColumn_ >= 0;
+
+    if (sorted && contacts.size() <= kIncrementalInsertMax)
+    {
+        for (Contact &c : contacts)
+        {
+            const int slot = static_cast<int>(store_.nextSlot());
+            const int pos = displayRowFor(ContactSortKeys::key(c, displayColumn_), slot);
+
+            beginInsertRows(QModelIndex(), pos, pos);
+            appendContact(std::move(c));
+            endInsertRows();
+        }
+        return;
+    }
+
+    const int first = liveRows_.size();
+    const int last = first + static_cast<int>(contacts.size()) - 1;
+
+    if (sorted)
+        beginResetModel();
+    else
+        beginInsertRows(QModelIndex(), first, last);
+
+    rows_.reserve(rows_.size() + contacts.size());
+    store_.reserve(static_cast<std::size_t>(store_.slotCount()) + contacts.size());
+    for (Contact &c : contacts)
+        appendContact(std::move(c));
+
+    if (sorted)
+        endResetModel();
+    else
+        endInsertRows();
+}
+
+void ContactTableModel::updateContact(Contact contact)
+{
+    if (paged_)
+    {
+        const int shown = pagedRowOfId(contact.id());
+        if (shown < 0)
+            return;
+
+        Page &page = pages_[static_cast<std::size_t>(shown / pageSize_)];
+        page.rows[static_cast<std::size_t>(shown % pageSize_)] = std::move(contact);
+        page.display[static_cast<std::size_t>(shown % pageSize_)] = DisplayCache{};
+        emit dataChanged(index(shown, 0), index(shown, columnCount() - 1));
+        return;
+    }
+
+    const auto it = slotById_.constFind(contact.id());
+    if (it == slotById_.constEnd())
+    {
+        insertContact(std::move(contact));
+        return;
+    }
+
+    const int slot = static_cast<int>(it.value());
+    const ContactId id = store_.idAt(it.value());
+    int shown = displayRowOf(slot);
+
+    searchIndex_.update(contact);
+    store_.update(id, contact);
+    display_[static_cast<std::size_t>(slot)] = DisplayCache{};
+    ++dataSeq_;
+
+    updateSortKeys(slot, displayColumn_);
+
+    if (displayColumn_ >= 0)
+    {
+        const std::size_t col = static_cast<std::size_t>(displayColumn_);
+        SortedPermutation &perm = sortPerms_[col];
+        QByteArray &key = sortKeys_[col][static_cast<std::size_t>(slot)];
+
+        perm.erase(slot);
+        key = ContactSortKeys::key(contact, displayColumn_);
+        const int pos = displayRowFor(key, slot);
+
+        if (pos != shown)
+        {
+            beginMoveRows(QModelIndex(), shown, shown, QModelIndex(), pos > shown ? pos + 1 : pos);
+            perm.insert(slot);
+            endMoveRows();
+            shown = pos;
+        }
+        else
+        {
+            perm.insert(slot);
+        }
+    }
+    emit dataChanged(index(shown, 0), index(shown, columnCount() - 1));
+}
+
+void ContactTableModel::removeContact(qint64 contactId)
+{
+    const auto it = slotById_.find(contactId);
+    if (paged_ || it == slotById_.end())
+        return;
+
+    const int slot = static_cast<int>(it.value());
+    const ContactId id = store_.idAt(it.value());
+    const int shown = displayRowOf(slot);
+    beginRemoveRows(QModelIndex(), shown, shown);
+
+    slotById_.erase(it);
+    searchIndex_.remove(contactId);
+    store_.remove(id);
+
+    const int pos = posOfSlot_[static_cast<std::size_t>(slot)];
+    rows_[static_cast<std::size_t>(pos)] = ContactId{};
+    liveRows_.remove(pos);
+    posOfSlot_[static_cast<std::size_t>(slot)] = -1;
+    ++tombstones_;
+    display_[static_cast<std::size_t>(slot)] = DisplayCache{};
+
+    for (std::size_t col = 0; col < sortKeys_.size(); ++col)
+    {
+        sortPerms_[col].erase(slot);
+        if (sortKeysValid_[col])
+            sortKeys_[col][static_cast<std::size_t>(slot)] = QByteArray();
+    }
+    ++dataSeq_;
+    endRemoveRows();
+
+    compactRows();
+}
+
+ContactView ContactTableModel::contactAt(int row) const
+{
+    if (row < 0 || row >= rowCount())
+        return ContactView();
+
+    if (!paged_)
+        return store_.view(store_.idAt(static_cast<quint32>(storageRow(row))));
+
+    const Page &page = pages_[static_cast<std::size_t>(row / pageSize_)];
+    const std::size_t offset = static_cast<std::size_t>(row % pageSize_);
+    if (!page.resident || offset >= page.rows.size())
+        return ContactView();
+    return ContactView(page.rows[offset]);
+}
+
+int ContactTableModel::rowOfId(qint64 id) const
+{
+    if (paged_)
+        return pagedRowOfId(id);
+
+    const auto it = slotById_.constFind(id);
+    return it == slotById_.constEnd() ? -1 : displayRowOf(static_cast<int>(it.value()));
+}
+
+std::shared_ptr<const std::vector<qint64>> ContactTableModel::rowIds() const
+{
+    if (rowIds_)
+        return rowIds_;
+
+    auto ids = std::make_shared<std::vector<qint64>>();
+    if (!paged_)
+    {
+        ids->reserve(static_cast<std::size_t>(liveRows_.size()));
+        if (displayColumn_ < 0)
+        {
+            for (const ContactId id : rows_)
+            {
+                if (id.isValid())
+                    ids->push_back(store_.view(id).id());
+            }
+        }
+        else
+        {
+            const std::vector<int> slots = sortPerms_[static_cast<std::size_t>(displayColumn_)].inOrder();
+            for (const int slot : slots)
+                ids->push_back(store_.view(store_.idAt(static_cast<quint32>(slot))).id());
+            if (displayOrder_ == Qt::DescendingOrder)
+                std::reverse(ids->begin(), ids->end());
+        }
+    }
+
+    rowIds_ = std::move(ids);
+    return rowIds_;
+}
+
+bool ContactTableModel::rowIdsCurrent(const std::shared_ptr<const std::vector<qint64>> &ids) const
+{
+    return ids && ids == rowIds_;
+}
+
+void ContactTableModel::setPaged(const ContactQuery &query, int pageSize, int residentPages)
+{
+    paged_ = true;
+    ++sortSeq_;
+    ++dataSeq_;
+    sortColumn_ = -1;
+    displayColumn_ = -1;
+    invalidateSortKeys();
+    rebuildIndex({});
+    query_ = query;
+    if (query_.sortColumn < 0 || query_.sortColumn > 4)
+        query_.sortColumn = 0;
+    pageSize_ = qMax(1, pageSize);
+    residentPages_ = qMax(2, residentPages);
+
+    resetPages();
 }
 
-void ContactTableModel::setContacts(const std::vector<Contact> &contacts)
+void ContactTableModel::setInMemory()
 {
+    if (!paged_)
+        return;
+
     beginResetModel();
-    contacts_ = contacts;
+    paged_ = false;
+    ++token_;
+    pages_.clear();
+    lru_.clear();
+    rowCount_ = 0;
+    fetching_ = false;
     endResetModel();
+
+    emit pagesReset();
+}
+
+bool ContactTableModel::isPaged() const
+{
+    return paged_;
+}
+
+void ContactTableModel::setSearchTerm(const QString &term)
+{
+    if (!paged_ || query_.term == term)
+        return;
+
+    query_.term = term;
+    resetPages();
 }
 
-const std::vector<Contact> &ContactTableModel::contacts() const
+void ContactTableModel::reload()
 {
-    return contacts_;
+    if (paged_)
+        resetPages();
+}
+
+void ContactTableModel::applyPage(quint64 token, int page, const ContactPage &result)
+{
+    if (!paged_ || token != token_ || page < 0)
+        return;
+
+    const std::size_t index = static_cast<std::size_t>(page);
+
+    if (index == pages_.size())
+    {
+        fetching_ = false;
+        hasMore_ = result.hasMore;
+        if (result.contacts.empty())
+        {
+            hasMore_ = false;
+            return;
+        }
+
+        Page p;
+        p.after = next_;
+        p.rows = result.contacts;
+        p.display.assign(p.rows.size(), DisplayCache{});
+        p.size = static_cast<int>(p.rows.size());
+        p.resident = true;
+
+        beginInsertRows(QModelIndex(), rowCount_, rowCount_ + p.size - 1);
+        pages_.push_back(std::move(p));
+        rowCount_ += pages_.back().size;
+        endInsertRows();
+
+        next_ = result.next;
+        touch(page);
+        evict();
+        return;
+    }
+
+    if (index > pages_.size())
+        return;
+
+    Page &p = pages_[index];
+    p.requested = false;
+    p.rows = result.contacts;
+    p.rows.resize(static_cast<std::size_t>(p.size));
+    p.display.assign(p.rows.size(), DisplayCache{});
+    p.resident = true;
+    touch(page);
+    evict();
+
+    const int first = page * pageSize_;
+    emit dataChanged(this->index(first, 0), this->index(first + p.size - 1, columnCount() - 1));
+}
+
+void ContactTableModel::pageFailed(quint64 token, int page)
+{
+    if (!paged_ || token != token_ || page < 0)
+        return;
+
+    const std::size_t index = static_cast<std::size_t>(page);
+    if (index == pages_.size())
+        fetching_ = false;
+    else if (index < pages_.size())
+        pages_[index].requested = false;
 }
 
 int ContactTableModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid())
         return 0;
-    return static_cast<int>(contacts_.size());
+    return paged_ ? rowCount_ : liveRows_.size();
 }
 
 int ContactTableModel::columnCount(const QModelIndex &parent) const
@@ -41,13 +441,23 @@ QVariant ContactTableModel::data(const QModelIndex &index, int role) const
     const int row = index.row();
     const int col = index.column();
 
-    if (row < 0 || static_cast<std::size_t>(row) >= contacts_.size())
-        return QVariant();
-
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    const Contact &c = contacts_[static_cast<std::size_t>(row)];
+    if (paged_ && row >= 0 && row < rowCount_)
+    {
+        const int page = row / pageSize_;
+        if (!pages_[static_cast<std::size_t>(page)].resident)
+        {
+            requestPage(page);
+            return QVariant();
+        }
+        touch(page);
+    }
+
+    const ContactView c = contactAt(row);
+    if (!c.isValid())
+        return QVariant();
 
     switch (col)
     {
@@ -60,9 +470,9 @@ QVariant ContactTableModel::data(const QModelIndex &index, int role) const
     case 3:
         return c.email();
     case 4:
-        return c.birthDate().isValid() ? c.birthDate().toString("dd.MM.yyyy") : QString();
+        return displayAt(row, c).birthDate;
     case 5:
-        return phonePreview(c);
+        return displayAt(row, c).phones;
     default:
         return QVariant();
     }
@@ -97,9 +507,351 @@ QVariant ContactTableModel::headerData(int section, Qt::Orientation orientation,
     return section + 1;
 }
 
-QString ContactTableModel::phonePreview(const Contact &c)
+bool ContactTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && paged_ && hasMore_ && !fetching_;
+}
+
+void ContactTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    fetching_ = true;
+    emit pageRequested(token_, static_cast<int>(pages_.size()), query_, next_, pageSize_);
+}
+
+void ContactTableModel::sort(int column, Qt::SortOrder order)
+{
+    if (!paged_)
+    {
+        sortInMemory(column, order);
+        return;
+    }
+
+    const int sortColumn = (column >= 0 && column <= 4) ? column : 0;
+    if (query_.sortColumn == sortColumn && query_.order == order)
+        return;
+
+    query_.sortColumn = sortColumn;
+    query_.order = order;
+    resetPages();
+}
+
+void ContactTableModel::resetPages()
+{
+    beginResetModel();
+    ++token_;
+    pages_.clear();
+    lru_.clear();
+    rowCount_ = 0;
+    next_ = ContactCursor{};
+    hasMore_ = true;
+    fetching_ = false;
+    endResetModel();
+
+    emit pagesReset();
+    fetchMore(QModelIndex());
+}
+
+const ContactTableModel::DisplayCache &ContactTableModel::displayAt(int row, const ContactView &c) const
+{
+    DisplayCache *cache = nullptr;
+    if (paged_)
+    {
+        Page &page = pages_[static_cast<std::size_t>(row / pageSize_)];
+        cache = &page.display[static_cast<std::size_t>(row % pageSize_)];
+    }
+    else
+    {
+        cache = &display_[static_cast<std::size_t>(storageRow(row))];
+    }
+
+    if (!cache->valid)
+    {
+        const QDate birthDate = c.birthDate();
+        cache->birthDate = birthDate.isValid() ? birthDate.toString("dd.MM.yyyy") : QString();
+        cache->phones = phonePreview(c);
+        cache->valid = true;
+    }
+    return *cache;
+}
+
+void ContactTableModel::rebuildIndex(const std::vector<Contact> &contacts)
+{
+    store_.clear();
+    store_.reserve(contacts.size());
+    rows_.clear();
+    rows_.reserve(contacts.size());
+    slotById_.clear();
+    slotById_.reserve(static_cast<int>(contacts.size()));
+    posOfSlot_.clear();
+    posOfSlot_.reserve(contacts.size());
+    for (const Contact &c : contacts)
+    {
+        const ContactId id = store_.add(c);
+        slotById_.insert(c.id(), id.index);
+        posOfSlot_.push_back(static_cast<int>(rows_.size()));
+        rows_.push_back(id);
+    }
+    liveRows_.assign(static_cast<int>(rows_.size()));
+    tombstones_ = 0;
+    display_.assign(rows_.size(), DisplayCache{});
+    searchIndex_.rebuild(contacts);
+}
+
+int ContactTableModel::storageRow(int row) const
+{
+    if (displayColumn_ < 0)
+        return static_cast<int>(rows_[static_cast<std::size_t>(liveRows_.select(row))].index);
+
+    const SortedPermutation &perm = sortPerms_[static_cast<std::size_t>(displayColumn_)];
+    return perm.at(displayOrder_ == Qt::AscendingOrder ? row : perm.size() - 1 - row);
+}
+
+int ContactTableModel::displayRowOf(int storage) const
+{
+    if (displayColumn_ < 0)
+        return liveRows_.rank(posOfSlot_[static_cast<std::size_t>(storage)]);
+
+    const SortedPermutation &perm = sortPerms_[static_cast<std::size_t>(displayColumn_)];
+    const int rank = perm.rankOf(storage);
+    return displayOrder_ == Qt::AscendingOrder ? rank : perm.size() - 1 - rank;
+}
+
+int ContactTableModel::displayRowFor(const QByteArray &key, int storage) const
+{
+    const SortedPermutation &perm = sortPerms_[static_cast<std::size_t>(displayColumn_)];
+    const int rank = perm.countLess(key, storage);
+    return displayOrder_ == Qt::AscendingOrder ? rank : perm.size() - rank;
+}
+
+void ContactTableModel::appendContact(Contact contact)
+{
+    searchIndex_.insert(contact);
+
+    const ContactId id = store_.add(contact);
+    const std::size_t slot = id.index;
+    if (slot >= display_.size())
+    {
+        display_.resize(slot + 1);
+        posOfSlot_.resize(slot + 1, -1);
+    }
+    display_[slot] = DisplayCache{};
+    slotById_.insert(contact.id(), id.index);
+    posOfSlot_[slot] = static_cast<int>(rows_.size());
+    rows_.push_back(id);
+    liveRows_.append();
+    updateSortKeys(static_cast<int>(slot));
+}
+
+void ContactTableModel::compactRows()
+{
+    if (tombstones_ < kCompactRowsMin || tombstones_ * 2 < rows_.size())
+        return;
+
+    std::size_t out = 0;
+    for (const ContactId id : rows_)
+    {
+        if (!id.isValid())
+            continue;
+        posOfSlot_[id.index] = static_cast<int>(out);
+        rows_[out++] = id;
+    }
+    rows_.resize(out);
+    liveRows_.assign(static_cast<int>(out));
+    tombstones_ = 0;
+}
+
+const std::vector<QByteArray> &ContactTableModel::ensureSortKeys(int column)
+{
+    std::vector<QByteArray> &keys = sortKeys_[static_cast<std::size_t>(column)];
+    if (sortKeysValid_[static_cast<std::size_t>(column)])
+        return keys;
+
+    keys.assign(static_cast<std::size_t>(store_.slotCount()), QByteArray());
+
+    std::vector<std::pair<std::size_t, std::size_t>> chunks;
+    for (std::size_t first = 0; first < rows_.size(); first += kSortKeyChunk)
+        chunks.emplace_back(first, std::min(rows_.size(), first + kSortKeyChunk));
+
+    QtConcurrent::blockingMap(chunks, [this, &keys, column](const std::pair<std::size_t, std::size_t> &chunk)
+                              {
+        for (std::size_t i = chunk.first; i < chunk.second; ++i)
+        {
+            if (rows_[i].isValid())
+                keys[rows_[i].index] = ContactSortKeys::key(store_.view(rows_[i]), column);
+        } });
+
+    sortKeysValid_[static_cast<std::size_t>(column)] = true;
+    return keys;
+}
+
+void ContactTableModel::updateSortKeys(int storage, int skipColumn)
+{
+    const std::size_t slot = static_cast<std::size_t>(storage);
+    const ContactView contact = store_.view(store_.idAt(static_cast<quint32>(storage)));
+    for (int col = 0; col < ContactSortKeys::kColumnCount; ++col)
+    {
+        if (col == skipColumn || !sortKeysValid_[static_cast<std::size_t>(col)])
+            continue;
+
+        std::vector<QByteArray> &keys = sortKeys_[static_cast<std::size_t>(col)];
+        SortedPermutation &perm = sortPerms_[static_cast<std::size_t>(col)];
+
+        if (slot >= keys.size())
+            keys.resize(slot + 1);
+        if (perm.isBuilt())
+            perm.erase(storage);
+        keys[slot] = ContactSortKeys::key(contact, col);
+        if (perm.isBuilt())
+            perm.insert(storage);
+    }
+}
+
+void ContactTableModel::invalidateSortKeys()
+{
+    for (std::size_t col = 0; col < sortKeys_.size(); ++col)
+    {
+        sortKeys_[col].clear();
+        sortKeys_[col].shrink_to_fit();
+        sortKeysValid_[col] = false;
+        sortPerms_[col].clear();
+    }
+}
+
+void ContactTableModel::sortInMemory(int column, Qt::SortOrder order)
+{
+    ++sortSeq_;
+
+    if (column < 0 || column >= ContactSortKeys::kColumnCount)
+    {
+        sortColumn_ = -1;
+        setDisplayOrder(-1, order);
+        return;
+    }
+
+    sortColumn_ = column;
+    sortOrder_ = order;
+
+    SortedPermutation &perm = sortPerms_[static_cast<std::size_t>(column)];
+    if (perm.isBuilt())
+    {
+        setDisplayOrder(column, order);
+        return;
+    }
+
+    const std::vector<QByteArray> &keys = ensureSortKeys(column);
+    if (keys.size() < kAsyncSortRows)
+    {
+        perm.build(&keys, liveSortedRows(keys));
+        setDisplayOrder(column, order);
+        return;
+    }
+
+    asyncSortSeq_ = sortSeq_;
+    asyncDataSeq_ = dataSeq_;
+    sortWatcher_.setFuture(QtConcurrent::run(&sortPool_, [keys]
+                                             { return liveSortedRows(keys); }));
+}
+
+void ContactTableModel::setDisplayOrder(int column, Qt::SortOrder order)
+{
+    if (column == displayColumn_ && (column < 0 || order == displayOrder_))
+        return;
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    const QModelIndexList from = persistentIndexList();
+    std::vector<int> storages;
+    storages.reserve(static_cast<std::size_t>(from.size()));
+    for (const QModelIndex &idx : from)
+        storages.push_back(storageRow(idx.row()));
+
+    displayColumn_ = column;
+    displayOrder_ = order;
+
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (int i = 0; i < from.size(); ++i)
+        to.append(index(displayRowOf(storages[static_cast<std::size_t>(i)]), from[i].column()));
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void ContactTableModel::onSortFinished()
+{
+    if (paged_ || asyncSortSeq_ != sortSeq_)
+        return;
+
+    if (asyncDataSeq_ != dataSeq_)
+    {
+        sortInMemory(sortColumn_, sortOrder_);
+        return;
+    }
+
+    const std::size_t col = static_cast<std::size_t>(sortColumn_);
+    sortPerms_[col].build(&sortKeys_[col], sortWatcher_.result());
+    setDisplayOrder(sortColumn_, sortOrder_);
+}
+
+int ContactTableModel::pagedRowOfId(qint64 id) const
+{
+    for (std::size_t p = 0; p < pages_.size(); ++p)
+    {
+        const Page &page = pages_[p];
+        if (!page.resident)
+            continue;
+
+        for (std::size_t i = 0; i < page.rows.size(); ++i)
+        {
+            if (page.rows[i].id() == id)
+                return static_cast<int>(p) * pageSize_ + static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void ContactTableModel::requestPage(int page) const
+{
+    Page &p = pages_[static_cast<std::size_t>(page)];
+    if (p.requested)
+        return;
+
+    p.requested = true;
+    auto *self = const_cast<ContactTableModel *>(this);
+    emit self->pageRequested(token_, page, query_, p.after, pageSize_);
+}
+
+void ContactTableModel::touch(int page) const
+{
+    if (!lru_.empty() && lru_.back() == page)
+        return;
+
+    const auto it = std::find(lru_.begin(), lru_.end(), page);
+    if (it != lru_.end())
+        lru_.erase(it);
+    lru_.push_back(page);
+}
+
+void ContactTableModel::evict() const
+{
+    while (static_cast<int>(lru_.size()) > residentPages_)
+    {
+        Page &victim = pages_[static_cast<std::size_t>(lru_.front())];
+        lru_.pop_front();
+        victim.rows.clear();
+        victim.rows.shrink_to_fit();
+        victim.display.clear();
+        victim.display.shrink_to_fit();
+        victim.resident = false;
+    }
+}
+
+QString ContactTableModel::phonePreview(const ContactView &c)
 {
-    const auto &phones = c.phoneNumbers();
+    const auto phones = c.phoneNumbers();
     if (phones.empty())
         return QString();
 
@@ -1,13 +1,23 @@
 #include "db_contact_repository.hpp"
 
 #include <QLoggingCategory>
+#include <QSqlDriver>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QVariant>
 #include <QUuid>
 #include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
 
 #include "phone_number.hpp"
+#include "schema_migrator.hpp"
+#include "search_key.hpp"
 
 #include <QCoreApplication>
 #include <QDir>
@@ -48,6 +58,271 @@ static QString diagnoseQpsqlPlugin()
 
 Q_LOGGING_CATEGORY(logDb, "phonebook.db")
 
+namespace
+{
+    int phoneTypeToDb(PhoneType type)
+    {
+        if (type == PhoneType::Work)
+            return 0;
+        if (type == PhoneType::Service)
+            return 2;
+        return 1;
+    }
+
+    PhoneType phoneTypeFromDb(int type)
+    {
+        if (type == 0)
+            return PhoneType::Work;
+        if (type == 2)
+            return PhoneType::Service;
+        return PhoneType::Home;
+    }
+
+    bool execOrFail(QSqlQuery &q, QString &error, const char *what)
+    {
+        if (q.exec())
+            return true;
+        error = q.lastError().text();
+        qCWarning(logDb) << what << "failed:" << error;
+        return false;
+    }
+
+    const char *const kChangeChannel = "phonebook_changes";
+    const char *const kBreakerOpenError = "DB circuit breaker is open";
+
+    // Only a lost or refused connection counts against the breaker. SQL
+    // errors (constraints, bad data) mean the server answered, so they
+    // are recorded as successes and reported through connectionError.
+    class BreakerScope
+    {
+    public:
+        BreakerScope(CircuitBreaker &breaker, const QString &error, QString connectionName, bool &connectionError)
+            : breaker_(breaker), error_(error), connectionName_(std::move(connectionName)), connectionError_(connectionError),
+              admitted_(breaker.allowRequest())
+        {
+            connectionError_ = !admitted_;
+        }
+
+        ~BreakerScope()
+        {
+            if (!admitted_)
+                return;
+
+            connectionError_ = !error_.isEmpty() && connectionLost();
+            if (connectionError_)
+                breaker_.recordFailure();
+            else
+                breaker_.recordSuccess();
+        }
+
+        bool admitted() const { return admitted_; }
+
+    private:
+        CircuitBreaker &breaker_;
+        const QString &error_;
+        QString connectionName_;
+        bool &connectionError_;
+        bool admitted_;
+
+        bool connectionLost()
+        {
+            QSqlDatabase database = QSqlDatabase::database(connectionName_, false);
+            if (!database.isOpen() || database.lastError().type() == QSqlError::ConnectionError)
+                return true;
+
+            QSqlQuery probe(database);
+            return !probe.exec("SELECT 1;");
+        }
+    };
+
+    constexpr std::size_t kBatchSize = 5000;
+    constexpr int kLoadBatchSize = 2000;
+
+    class PgArray
+    {
+    public:
+        void add(const QString &value)
+        {
+            separator();
+            out_ += '"';
+            for (const QChar ch : value)
+            {
+                if (ch == '"' || ch == '\\')
+                    out_ += '\\';
+                out_ += ch;
+            }
+            out_ += '"';
+        }
+
+        void add(qint64 value)
+        {
+            separator();
+            out_ += QString::number(value);
+        }
+
+        void add(const QDate &value)
+        {
+            separator();
+            out_ += value.isValid() ? value.toString(Qt::ISODate) : QStringLiteral("NULL");
+        }
+
+        QString literal() const
+        {
+            return out_.isEmpty() ? QStringLiteral("{}") : out_ + '}';
+        }
+
+    private:
+        QString out_;
+
+        void separator()
+        {
+            out_ += out_.isEmpty() ? '{' : ',';
+        }
+    };
+
+    struct ContactBatch
+    {
+        PgArray ids, firstNames, lastNames, middleNames, addresses, birthDates, emails, searchKeys;
+
+        void add(const Contact &c)
+        {
+            ids.add(c.id());
+            firstNames.add(c.firstName());
+            lastNames.add(c.lastName());
+            middleNames.add(c.middleName());
+            addresses.add(c.address());
+            birthDates.add(c.birthDate());
+            emails.add(c.email());
+            searchKeys.add(QString::fromUtf8(SearchKey::forContact(c)));
+        }
+
+        void bind(QSqlQuery &q) const
+        {
+            q.bindValue(0, ids.literal());
+            q.bindValue(1, firstNames.literal());
+            q.bindValue(2, lastNames.literal());
+            q.bindValue(3, middleNames.literal());
+            q.bindValue(4, addresses.literal());
+            q.bindValue(5, birthDates.literal());
+            q.bindValue(6, emails.literal());
+            q.bindValue(7, searchKeys.literal());
+        }
+    };
+
+    struct PhoneBatch
+    {
+        PgArray contactIds, types, values;
+        std::size_t size = 0;
+
+        void add(const Contact &c)
+        {
+            for (const auto &ph : c.phoneNumbers())
+            {
+                contactIds.add(c.id());
+                types.add(static_cast<qint64>(phoneTypeToDb(ph.type())));
+                values.add(ph.value());
+                ++size;
+            }
+        }
+
+        void bind(QSqlQuery &q) const
+        {
+            q.bindValue(0, contactIds.literal());
+            q.bindValue(1, types.literal());
+            q.bindValue(2, values.literal());
+        }
+    };
+
+    template <typename Item, typename Fn>
+    bool forEachBatch(const std::vector<Item> &items, Fn fn)
+    {
+        for (std::size_t from = 0; from < items.size(); from += kBatchSize)
+        {
+            const std::size_t to = std::min(items.size(), from + kBatchSize);
+            if (!fn(from, to))
+                return false;
+        }
+        return true;
+    }
+
+    const char *const kContactColumns =
+        "c.id, c.first_name, c.last_name, c.middle_name, c.address, c.birth_date, c.email, "
+        "COALESCE((SELECT json_agg(json_build_array(p.type, p.value) ORDER BY p.id) "
+        "FROM phones p WHERE p.contact_id = c.id), '[]'::json)";
+
+    Contact contactFromRow(const QSqlQuery &q)
+    {
+        Contact contact;
+        contact.setId(q.value(0).toLongLong());
+        contact.setFirstName(q.value(1).toString());
+        contact.setLastName(q.value(2).toString());
+        contact.setMiddleName(q.value(3).toString());
+        contact.setAddress(q.value(4).toString());
+        contact.setBirthDate(q.value(5).toDate());
+        contact.setEmail(q.value(6).toString());
+
+        std::vector<PhoneNumber> phones;
+        const QJsonArray rows = QJsonDocument::fromJson(q.value(7).toString().toUtf8()).array();
+        phones.reserve(static_cast<std::size_t>(rows.size()));
+        for (const QJsonValue &row : rows)
+        {
+            const QJsonArray pair = row.toArray();
+            phones.emplace_back(phoneTypeFromDb(pair.at(0).toInt()), pair.at(1).toString());
+        }
+        contact.setPhoneNumbers(std::move(phones));
+        return contact;
+    }
+
+    struct SortKey
+    {
+        const char *expression;
+        const char *type;
+    };
+
+    SortKey sortKeyFor(int column)
+    {
+        switch (column)
+        {
+        case 1:
+            return {"c.first_name", "text"};
+        case 2:
+            return {"c.middle_name", "text"};
+        case 3:
+            return {"c.email", "text"};
+        case 4:
+            return {"COALESCE(c.birth_date, DATE '0001-01-01')", "date"};
+        default:
+            return {"c.last_name", "text"};
+        }
+    }
+
+    QString sortKeyValue(const Contact &c, int column)
+    {
+        switch (column)
+        {
+        case 1:
+            return c.firstName();
+        case 2:
+            return c.middleName();
+        case 3:
+            return c.email();
+        case 4:
+            return c.birthDate().isValid() ? c.birthDate().toString(Qt::ISODate) : QStringLiteral("0001-01-01");
+        default:
+            return c.lastName();
+        }
+    }
+
+    QString likePattern(const QString &term)
+    {
+        QString escaped = term;
+        escaped.replace('\\', "\\\\");
+        escaped.replace('%', "\\%");
+        escaped.replace('_', "\\_");
+        return QString("%") + escaped + '%';
+    }
+}
+
 DbContactRepository::DbContactRepository(QString host,
                                          int port,
                                          QString dbName,
@@ -91,6 +366,7 @@ bool DbContactRepository::initialize()
         return false;
 
     available_ = true;
+    breaker_.reset();
     return true;
 }
 
@@ -99,11 +375,31 @@ bool DbContactRepository::isAvailable() const
     return available_;
 }
 
+void DbContactRepository::disconnect()
+{
+    available_ = false;
+    schemaReady_ = false;
+    snapshotValid_ = false;
+
+    if (QSqlDatabase::contains(connectionName_))
+        db().close();
+}
+
+CircuitBreaker &DbContactRepository::circuitBreaker()
+{
+    return breaker_;
+}
+
 QString DbContactRepository::lastError() const
 {
     return lastError_;
 }
 
+bool DbContactRepository::lastErrorIsConnection() const
+{
+    return connectionError_ && !lastError_.isEmpty();
+}
+
 QSqlDatabase DbContactRepository::db()
 {
     if (QSqlDatabase::contains(connectionName_))
@@ -129,7 +425,10 @@ bool DbContactRepository::open()
 
     if (database.open())
     {
+        schemaReady_ = false;
         qCInfo(logDb) << "DB connected:" << database.hostName() << database.port() << database.databaseName() << database.userName();
+        if (changeHandler_)
+            listen();
         return true;
     }
 
@@ -142,142 +441,411 @@ bool DbContactRepository::ensureSchema()
 {
     lastError_.clear();
 
-    QSqlDatabase database = db();
-    QSqlQuery q(database);
-
-    if (!q.exec("CREATE TABLE IF NOT EXISTS contacts ("
-                "id BIGSERIAL PRIMARY KEY,"
-                "first_name TEXT NOT NULL,"
-                "last_name TEXT NOT NULL,"
-                "middle_name TEXT NOT NULL DEFAULT '',"
-                "address TEXT NOT NULL DEFAULT '',"
-                "birth_date DATE,"
-                "email TEXT NOT NULL"
-                ");"))
-    {
-        lastError_ = q.lastError().text();
-        qCWarning(logDb) << "ensureSchema contacts failed:" << lastError_;
-        return false;
-    }
+    if (schemaReady_)
+        return true;
 
-    if (!q.exec("CREATE TABLE IF NOT EXISTS phones ("
-                "id BIGSERIAL PRIMARY KEY,"
-                "contact_id BIGINT NOT NULL REFERENCES contacts(id) ON DELETE CASCADE,"
-                "type SMALLINT NOT NULL,"
-                "value TEXT NOT NULL"
-                ");"))
+    SchemaMigrator migrator(db());
+    if (!migrator.migrate())
     {
-        lastError_ = q.lastError().text();
-        qCWarning(logDb) << "ensureSchema phones failed:" << lastError_;
+        lastError_ = migrator.lastError();
         return false;
     }
 
-    q.exec("CREATE INDEX IF NOT EXISTS idx_contacts_last_name ON contacts(last_name);");
-    q.exec("CREATE INDEX IF NOT EXISTS idx_contacts_first_name ON contacts(first_name);");
-    q.exec("CREATE INDEX IF NOT EXISTS idx_contacts_email ON contacts(email);");
-    q.exec("CREATE INDEX IF NOT EXISTS idx_phones_value ON phones(value);");
+    qCInfo(logDb) << "Schema version" << migrator.currentVersion();
+    if (!backfillSearchKeys())
+        return false;
 
-    qCInfo(logDb) << "Schema ensured";
+    schemaReady_ = true;
+    return true;
+}
+
+bool DbContactRepository::backfillSearchKeys()
+{
+    QSqlDatabase database = db();
+
+    QSqlQuery select(database);
+    select.setForwardOnly(true);
+    select.prepare(QString("SELECT %1 FROM contacts c WHERE c.search_key = '' AND c.id > ? ORDER BY c.id LIMIT ?;")
+                       .arg(kContactColumns));
+
+    QSqlQuery update(database);
+    update.prepare("UPDATE contacts AS c SET search_key = u.search_key "
+                   "FROM unnest(?::bigint[], ?::text[]) AS u(id, search_key) "
+                   "WHERE c.id = u.id AND c.search_key = '';");
+
+    qint64 lastId = std::numeric_limits<qint64>::min();
+    std::size_t filled = 0;
+    for (;;)
+    {
+        select.bindValue(0, lastId);
+        select.bindValue(1, kLoadBatchSize);
+        if (!execOrFail(select, lastError_, "select rows without search key"))
+            return false;
+
+        PgArray ids, keys;
+        int rows = 0;
+        while (select.next())
+        {
+            const Contact c = contactFromRow(select);
+            ids.add(c.id());
+            keys.add(QString::fromUtf8(SearchKey::forContact(c)));
+            lastId = c.id();
+            ++rows;
+        }
+        select.finish();
+
+        if (rows == 0)
+            break;
+
+        update.bindValue(0, ids.literal());
+        update.bindValue(1, keys.literal());
+        if (!execOrFail(update, lastError_, "backfill search keys"))
+            return false;
+
+        filled += static_cast<std::size_t>(rows);
+        if (rows < kLoadBatchSize)
+            break;
+    }
+
+    if (filled > 0)
+        qCInfo(logDb) << "search_key backfilled for" << filled << "contacts";
     return true;
 }
 
 std::vector<Contact> DbContactRepository::loadAll()
+{
+    std::vector<Contact> contacts;
+    loadBatched(kLoadBatchSize, [&contacts](std::vector<Contact> &&batch)
+                {
+        if (contacts.empty())
+            contacts = std::move(batch);
+        else
+            std::move(batch.begin(), batch.end(), std::back_inserter(contacts));
+        return true; });
+
+    if (!lastError_.isEmpty())
+        return {};
+
+    qCInfo(logDb) << "loadAll OK. contacts:" << contacts.size();
+    return contacts;
+}
+
+bool DbContactRepository::loadBatched(int batchSize, const std::function<bool(std::vector<Contact> &&)> &sink)
 {
     lastError_.clear();
+    snapshotValid_ = false;
+
+    BreakerScope breaker(breaker_, lastError_, connectionName_, connectionError_);
+    if (!breaker.admitted())
+    {
+        lastError_ = kBreakerOpenError;
+        return false;
+    }
 
     if (!open())
-        return {};
+        return false;
 
     if (!ensureSchema())
-        return {};
+        return false;
+
+    return readRows(batchSize, sink);
+}
 
+bool DbContactRepository::readRows(int batchSize, const std::function<bool(std::vector<Contact> &&)> &sink)
+{
     QSqlDatabase database = db();
+    if (!database.transaction())
+    {
+        lastError_ = database.lastError().text();
+        qCWarning(logDb) << "loadBatched transaction failed:" << lastError_;
+        return false;
+    }
 
-    QSqlQuery c(database);
-    if (!c.exec("SELECT id, first_name, last_name, middle_name, address, birth_date, email "
-                "FROM contacts ORDER BY id;"))
+    QSqlQuery cursor(database);
+    cursor.setForwardOnly(true);
+    if (!cursor.exec(QString("DECLARE phonebook_load NO SCROLL CURSOR FOR "
+                             "SELECT %1 FROM contacts c ORDER BY c.id;")
+                         .arg(kContactColumns)))
     {
-        lastError_ = c.lastError().text();
-        qCWarning(logDb) << "loadAll contacts query failed:" << lastError_;
-        return {};
+        lastError_ = cursor.lastError().text();
+        database.rollback();
+        qCWarning(logDb) << "loadBatched declare cursor failed:" << lastError_;
+        return false;
     }
 
-    std::vector<Contact> contacts;
-    contacts.reserve(256);
+    QHash<qint64, RowDigest> snapshot;
+    const QString fetchSql = QString("FETCH %1 FROM phonebook_load;").arg(qMax(1, batchSize));
 
-    QHash<qint64, int> idToIndex;
+    QSqlQuery fetch(database);
+    fetch.setForwardOnly(true);
 
-    while (c.next())
+    while (true)
     {
-        const qint64 id = c.value(0).toLongLong();
+        if (!fetch.exec(fetchSql))
+        {
+            lastError_ = fetch.lastError().text();
+            database.rollback();
+            qCWarning(logDb) << "loadBatched fetch failed:" << lastError_;
+            return false;
+        }
 
-        Contact contact;
-        contact.setFirstName(c.value(1).toString());
-        contact.setLastName(c.value(2).toString());
-        contact.setMiddleName(c.value(3).toString());
-        contact.setAddress(c.value(4).toString());
-        contact.setBirthDate(c.value(5).toDate());
-        contact.setEmail(c.value(6).toString());
+        std::vector<Contact> batch;
+        batch.reserve(static_cast<std::size_t>(qMax(1, batchSize)));
 
-        idToIndex.insert(id, static_cast<int>(contacts.size()));
-        contacts.push_back(std::move(contact));
+        while (fetch.next())
+        {
+            Contact contact = contactFromRow(fetch);
+            snapshot.insert(contact.id(), RowDigest{contactFieldsDigest(contact), phonesDigest(contact.phoneNumbers())});
+            batch.push_back(std::move(contact));
+        }
+
+        if (batch.empty())
+            break;
+
+        if (!sink(std::move(batch)))
+        {
+            database.rollback();
+            qCInfo(logDb) << "loadBatched canceled by caller";
+            return false;
+        }
     }
 
-    if (contacts.empty())
+    QSqlQuery closeCursor(database);
+    closeCursor.exec("CLOSE phonebook_load;");
+    database.commit();
+
+    snapshot_ = std::move(snapshot);
+    snapshotValid_ = true;
+    return true;
+}
+
+ContactPage DbContactRepository::searchPage(const ContactQuery &query, const ContactCursor &after, int limit)
+{
+    lastError_.clear();
+
+    ContactPage page;
+    BreakerScope breaker(breaker_, lastError_, connectionName_, connectionError_);
+    if (!breaker.admitted())
     {
-        qCInfo(logDb) << "loadAll: DB empty";
-        return contacts;
+        lastError_ = kBreakerOpenError;
+        return page;
     }
 
-    QSqlQuery p(database);
-    if (!p.exec("SELECT contact_id, type, value FROM phones ORDER BY contact_id, id;"))
+    if (!open() || !ensureSchema())
+        return page;
+
+    const QString t = query.term.trimmed();
+    const int pageSize = qMax(1, limit);
+    const SortKey key = sortKeyFor(query.sortColumn);
+    const bool descending = query.order == Qt::DescendingOrder;
+
+    QString sql = QString("SELECT %1 FROM contacts c ").arg(kContactColumns);
+    if (!t.isEmpty())
     {
-        lastError_ = p.lastError().text();
-        qCWarning(logDb) << "loadAll phones query failed:" << lastError_;
-        return {};
+        sql += "JOIN ("
+               "SELECT id FROM contacts WHERE search_key LIKE :k "
+               "UNION "
+               "SELECT id FROM contacts WHERE search_key = '' "
+               "AND (first_name ILIKE :p OR last_name ILIKE :p OR middle_name ILIKE :p OR email ILIKE :p) "
+               "UNION "
+               "SELECT p.contact_id FROM phones p JOIN contacts k ON k.id = p.contact_id "
+               "WHERE k.search_key = '' AND p.value ILIKE :p"
+               ") hits ON hits.id = c.id ";
+    }
+    if (after.valid)
+    {
+        sql += QString("WHERE (%1, c.id) %2 (CAST(:key AS %3), :id) ")
+                   .arg(QLatin1String(key.expression), QLatin1String(descending ? "<" : ">"), QLatin1String(key.type));
+    }
+    sql += QString("ORDER BY %1 %2, c.id %2 LIMIT %3;")
+               .arg(QLatin1String(key.expression), QLatin1String(descending ? "DESC" : "ASC"))
+               .arg(pageSize + 1);
+
+    QSqlQuery q(db());
+    q.setForwardOnly(true);
+    q.prepare(sql);
+    if (!t.isEmpty())
+    {
+        q.bindValue(":k", likePattern(QString::fromUtf8(SearchKey::normalize(t))));
+        q.bindValue(":p", likePattern(t));
+    }
+    if (after.valid)
+    {
+        q.bindValue(":key", after.key);
+        q.bindValue(":id", after.id);
     }
 
-    std::vector<std::vector<PhoneNumber>> phonesByRow;
-    phonesByRow.resize(contacts.size());
+    if (!execOrFail(q, lastError_, "searchPage"))
+        return page;
 
-    while (p.next())
+    page.contacts.reserve(static_cast<std::size_t>(pageSize));
+    while (q.next())
     {
-        const qint64 contactId = p.value(0).toLongLong();
-        const int type = p.value(1).toInt();
-        const QString value = p.value(2).toString();
+        if (static_cast<int>(page.contacts.size()) == pageSize)
+        {
+            page.hasMore = true;
+            break;
+        }
+        page.contacts.push_back(contactFromRow(q));
+    }
 
-        auto it = idToIndex.find(contactId);
-        if (it == idToIndex.end())
-            continue;
+    if (!page.contacts.empty())
+    {
+        const Contact &last = page.contacts.back();
+        page.next = ContactCursor{sortKeyValue(last, query.sortColumn), last.id(), true};
+    }
+    return page;
+}
 
-        PhoneType phoneType = PhoneType::Home;
-        if (type == 0)
-            phoneType = PhoneType::Work;
-        else if (type == 2)
-            phoneType = PhoneType::Service;
+std::vector<Contact> DbContactRepository::fetchByIds(const std::vector<qint64> &ids)
+{
+    lastError_.clear();
 
-        phonesByRow[static_cast<std::size_t>(*it)].emplace_back(phoneType, value);
+    std::vector<Contact> contacts;
+    if (ids.empty())
+        return contacts;
+
+    BreakerScope breaker(breaker_, lastError_, connectionName_, connectionError_);
+    if (!breaker.admitted())
+    {
+        lastError_ = kBreakerOpenError;
+        return contacts;
     }
 
-    for (std::size_t i = 0; i < contacts.size(); ++i)
+    if (!open() || !ensureSchema())
+        return contacts;
+
+    PgArray idArray;
+    for (const qint64 id : ids)
+        idArray.add(id);
+
+    QSqlQuery q(db());
+    q.setForwardOnly(true);
+    q.prepare(QString("SELECT %1 FROM contacts c WHERE c.id = ANY(?::bigint[]);").arg(kContactColumns));
+    q.addBindValue(idArray.literal());
+    if (!execOrFail(q, lastError_, "fetchByIds"))
+        return contacts;
+
+    contacts.reserve(ids.size());
+    while (q.next())
+        contacts.push_back(contactFromRow(q));
+
+    if (snapshotValid_)
     {
-        contacts[i].setPhoneNumbers(std::move(phonesByRow[i]));
+        for (const qint64 id : ids)
+            snapshot_.remove(id);
+        for (const Contact &c : contacts)
+            snapshot_.insert(c.id(), RowDigest{contactFieldsDigest(c), phonesDigest(c.phoneNumbers())});
     }
 
-    qCInfo(logDb) << "loadAll OK. contacts:" << contacts.size();
     return contacts;
 }
 
+bool DbContactRepository::subscribeToChanges(std::function<void(qint64)> handler)
+{
+    lastError_.clear();
+    changeHandler_ = std::move(handler);
+
+    if (!open())
+        return false;
+    return listen();
+}
+
+bool DbContactRepository::listen()
+{
+    QSqlDriver *driver = db().driver();
+    QObject::disconnect(notifyConnection_);
+
+    if (!driver->subscribedToNotifications().contains(kChangeChannel) &&
+        !driver->subscribeToNotification(kChangeChannel))
+    {
+        lastError_ = driver->lastError().text();
+        qCWarning(logDb) << "LISTEN failed:" << lastError_;
+        return false;
+    }
+
+    notifyConnection_ = QObject::connect(
+        driver, QOverload<const QString &, QSqlDriver::NotificationSource, const QVariant &>::of(&QSqlDriver::notification),
+        [this](const QString &name, QSqlDriver::NotificationSource source, const QVariant &payload)
+        {
+            if (name != kChangeChannel || source == QSqlDriver::SelfSource || !changeHandler_)
+                return;
+
+            bool ok = false;
+            const qint64 id = payload.toString().toLongLong(&ok);
+            if (ok)
+                changeHandler_(id);
+        });
+
+    qCInfo(logDb) << "Listening on" << kChangeChannel;
+    return true;
+}
+
 void DbContactRepository::saveAll(const std::vector<Contact> &contacts)
 {
     lastError_.clear();
 
+    BreakerScope breaker(breaker_, lastError_, connectionName_, connectionError_);
+    if (!breaker.admitted())
+    {
+        lastError_ = kBreakerOpenError;
+        return;
+    }
+
     if (!open())
         return;
 
     if (!ensureSchema())
         return;
 
+    if (!snapshotValid_ && !readRows(kLoadBatchSize, [](std::vector<Contact> &&)
+                                     { return true; }))
+        return;
+
+    QHash<qint64, RowDigest> next;
+    next.reserve(static_cast<int>(contacts.size()));
+
+    std::vector<const Contact *> inserts;
+    std::vector<const Contact *> fieldUpdates;
+    std::vector<const Contact *> phoneUpdates;
+
+    for (const auto &c : contacts)
+    {
+        if (c.id() == 0 || next.contains(c.id()))
+        {
+            qCWarning(logDb) << "saveAll: skipping contact without a unique id:" << c.lastName() << c.firstName();
+            continue;
+        }
+
+        const RowDigest digest{contactFieldsDigest(c), phonesDigest(c.phoneNumbers())};
+        next.insert(c.id(), digest);
+
+        const auto it = snapshot_.constFind(c.id());
+        if (it == snapshot_.constEnd())
+        {
+            inserts.push_back(&c);
+            continue;
+        }
+
+        if (it->fields != digest.fields || it->phones != digest.phones)
+            fieldUpdates.push_back(&c);
+        if (it->phones != digest.phones)
+            phoneUpdates.push_back(&c);
+    }
+
+    std::vector<qint64> deletes;
+    for (auto it = snapshot_.constBegin(); it != snapshot_.constEnd(); ++it)
+    {
+        if (!next.contains(it.key()))
+            deletes.push_back(it.key());
+    }
+
+    if (inserts.empty() && fieldUpdates.empty() && phoneUpdates.empty() && deletes.empty())
+    {
+        qCInfo(logDb) << "saveAll: nothing changed";
+        return;
+    }
+
     QSqlDatabase database = db();
     if (!database.transaction())
     {
@@ -286,94 +854,219 @@ void DbContactRepository::saveAll(const std::vector<Contact> &contacts)
         return;
     }
 
-    QSqlQuery q(database);
-
-    if (!q.exec("DELETE FROM phones;"))
+    const auto rollback = [&]
     {
-        lastError_ = q.lastError().text();
         database.rollback();
-        qCWarning(logDb) << "delete phones failed:" << lastError_;
-        return;
+        snapshotValid_ = false;
+    };
+
+    const auto idArray = [](const auto &items, std::size_t from, std::size_t to)
+    {
+        PgArray ids;
+        for (std::size_t i = from; i < to; ++i)
+            ids.add(items[i]);
+        return ids.literal();
+    };
+
+    QSqlQuery deleteContacts(database);
+    deleteContacts.prepare("DELETE FROM contacts WHERE id = ANY(?::bigint[]);");
+    const bool deletedOk = forEachBatch(deletes, [&](std::size_t from, std::size_t to)
+                                        {
+        deleteContacts.bindValue(0, idArray(deletes, from, to));
+        return execOrFail(deleteContacts, lastError_, "delete contacts"); });
+    if (!deletedOk)
+        return rollback();
+
+    QSqlQuery insertContacts(database);
+    insertContacts.prepare(
+        "INSERT INTO contacts(id, first_name, last_name, middle_name, address, birth_date, email, search_key) "
+        "SELECT * FROM unnest(?::bigint[], ?::text[], ?::text[], ?::text[], ?::text[], ?::date[], ?::text[], ?::text[]);");
+    const bool insertedOk = forEachBatch(inserts, [&](std::size_t from, std::size_t to)
+                                         {
+        ContactBatch batch;
+        for (std::size_t i = from; i < to; ++i)
+            batch.add(*inserts[i]);
+        batch.bind(insertContacts);
+        return execOrFail(insertContacts, lastError_, "insert contacts"); });
+    if (!insertedOk)
+        return rollback();
+
+    QSqlQuery updateContacts(database);
+    updateContacts.prepare(
+        "UPDATE contacts AS c SET first_name = u.first_name, last_name = u.last_name, "
+        "middle_name = u.middle_name, address = u.address, birth_date = u.birth_date, email = u.email, "
+        "search_key = u.search_key "
+        "FROM unnest(?::bigint[], ?::text[], ?::text[], ?::text[], ?::text[], ?::date[], ?::text[], ?::text[]) "
+        "AS u(id, first_name, last_name, middle_name, address, birth_date, email, search_key) "
+        "WHERE c.id = u.id;");
+    const bool updatedOk = forEachBatch(fieldUpdates, [&](std::size_t from, std::size_t to)
+                                        {
+        ContactBatch batch;
+        for (std::size_t i = from; i < to; ++i)
+            batch.add(*fieldUpdates[i]);
+        batch.bind(updateContacts);
+        return execOrFail(updateContacts, lastError_, "update contacts"); });
+    if (!updatedOk)
+        return rollback();
+
+    QSqlQuery deletePhones(database);
+    deletePhones.prepare("DELETE FROM phones WHERE contact_id = ANY(?::bigint[]);");
+    const bool phonesDeletedOk = forEachBatch(phoneUpdates, [&](std::size_t from, std::size_t to)
+                                              {
+        PgArray ids;
+        for (std::size_t i = from; i < to; ++i)
+            ids.add(phoneUpdates[i]->id());
+        deletePhones.bindValue(0, ids.literal());
+        return execOrFail(deletePhones, lastError_, "delete phones"); });
+    if (!phonesDeletedOk)
+        return rollback();
+
+    QSqlQuery insertPhones(database);
+    insertPhones.prepare(
+        "INSERT INTO phones(contact_id, type, value) "
+        "SELECT u.contact_id, u.type, u.value "
+        "FROM unnest(?::bigint[], ?::smallint[], ?::text[]) WITH ORDINALITY AS u(contact_id, type, value, n) "
+        "ORDER BY u.n;");
+    std::vector<const Contact *> phoneOwners;
+    phoneOwners.reserve(inserts.size() + phoneUpdates.size());
+    phoneOwners.insert(phoneOwners.end(), inserts.begin(), inserts.end());
+    phoneOwners.insert(phoneOwners.end(), phoneUpdates.begin(), phoneUpdates.end());
+    const bool phonesInsertedOk = forEachBatch(phoneOwners, [&](std::size_t from, std::size_t to)
+                                               {
+        PhoneBatch batch;
+        for (std::size_t i = from; i < to; ++i)
+            batch.add(*phoneOwners[i]);
+        if (batch.size == 0)
+            return true;
+        batch.bind(insertPhones);
+        return execOrFail(insertPhones, lastError_, "insert phones"); });
+    if (!phonesInsertedOk)
+        return rollback();
+
+    if (!database.commit())
+    {
+        lastError_ = database.lastError().text();
+        qCWarning(logDb) << "commit failed:" << lastError_;
+        return rollback();
     }
 
-    if (!q.exec("DELETE FROM contacts;"))
+    snapshot_ = std::move(next);
+    qCInfo(logDb) << "saveAll OK. inserted:" << inserts.size()
+                  << "updated:" << fieldUpdates.size()
+                  << "phones rewritten:" << phoneUpdates.size()
+                  << "deleted:" << deletes.size();
+}
+
+void DbContactRepository::applyChanges(const std::vector<ContactChange> &changes)
+{
+    lastError_.clear();
+
+    BreakerScope breaker(breaker_, lastError_, connectionName_, connectionError_);
+    if (!breaker.admitted())
     {
-        lastError_ = q.lastError().text();
-        database.rollback();
-        qCWarning(logDb) << "delete contacts failed:" << lastError_;
+        lastError_ = kBreakerOpenError;
         return;
     }
 
-    QSqlQuery insertContact(database);
-    if (!insertContact.prepare(
-            "INSERT INTO contacts(first_name, last_name, middle_name, address, birth_date, email) "
-            "VALUES (?, ?, ?, ?, ?, ?) RETURNING id;"))
-    {
-        lastError_ = insertContact.lastError().text();
-        database.rollback();
-        qCWarning(logDb) << "prepare insertContact failed:" << lastError_;
+    if (!open() || !ensureSchema())
         return;
+
+    std::vector<const Contact *> upserts;
+    std::vector<qint64> deletes;
+    for (const ContactChange &change : changes)
+    {
+        if (change.kind == ContactChange::Kind::Remove)
+            deletes.push_back(change.id);
+        else if (change.id != 0)
+            upserts.push_back(&change.contact);
     }
 
-    QSqlQuery insertPhone(database);
-    if (!insertPhone.prepare("INSERT INTO phones(contact_id, type, value) VALUES (?, ?, ?);"))
+    if (upserts.empty() && deletes.empty())
+        return;
+
+    QSqlDatabase database = db();
+    if (!database.transaction())
     {
-        lastError_ = insertPhone.lastError().text();
-        database.rollback();
-        qCWarning(logDb) << "prepare insertPhone failed:" << lastError_;
+        lastError_ = database.lastError().text();
+        qCWarning(logDb) << "transaction failed:" << lastError_;
         return;
     }
 
-    for (const auto &c : contacts)
+    const auto rollback = [&]
     {
-        insertContact.bindValue(0, c.firstName());
-        insertContact.bindValue(1, c.lastName());
-        insertContact.bindValue(2, c.middleName());
-        insertContact.bindValue(3, c.address());
-        insertContact.bindValue(4, c.birthDate());
-        insertContact.bindValue(5, c.email());
-
-        if (!insertContact.exec())
+        database.rollback();
+        snapshotValid_ = false;
+    };
+
+    QSqlQuery deleteContacts(database);
+    deleteContacts.prepare("DELETE FROM contacts WHERE id = ANY(?::bigint[]);");
+    const bool deletedOk = forEachBatch(deletes, [&](std::size_t from, std::size_t to)
+                                        {
+        PgArray ids;
+        for (std::size_t i = from; i < to; ++i)
+            ids.add(deletes[i]);
+        deleteContacts.bindValue(0, ids.literal());
+        return execOrFail(deleteContacts, lastError_, "delete contacts"); });
+    if (!deletedOk)
+        return rollback();
+
+    QSqlQuery upsertContacts(database);
+    upsertContacts.prepare(
+        "INSERT INTO contacts(id, first_name, last_name, middle_name, address, birth_date, email, search_key) "
+        "SELECT * FROM unnest(?::bigint[], ?::text[], ?::text[], ?::text[], ?::text[], ?::date[], ?::text[], ?::text[]) "
+        "ON CONFLICT (id) DO UPDATE SET first_name = EXCLUDED.first_name, last_name = EXCLUDED.last_name, "
+        "middle_name = EXCLUDED.middle_name, address = EXCLUDED.address, birth_date = EXCLUDED.birth_date, "
+        "email = EXCLUDED.email, search_key = EXCLUDED.search_key;");
+    QSqlQuery deletePhones(database);
+    deletePhones.prepare("DELETE FROM phones WHERE contact_id = ANY(?::bigint[]);");
+    QSqlQuery insertPhones(database);
+    insertPhones.prepare(
+        "INSERT INTO phones(contact_id, type, value) "
+        "SELECT u.contact_id, u.type, u.value "
+        "FROM unnest(?::bigint[], ?::smallint[], ?::text[]) WITH ORDINALITY AS u(contact_id, type, value, n) "
+        "ORDER BY u.n;");
+
+    const bool upsertedOk = forEachBatch(upserts, [&](std::size_t from, std::size_t to)
+                                         {
+        ContactBatch contacts;
+        PgArray ids;
+        PhoneBatch phones;
+        for (std::size_t i = from; i < to; ++i)
         {
-            lastError_ = insertContact.lastError().text();
-            database.rollback();
-            qCWarning(logDb) << "insert contact failed:" << lastError_;
-            return;
+            contacts.add(*upserts[i]);
+            ids.add(upserts[i]->id());
+            phones.add(*upserts[i]);
         }
 
-        qint64 contactId = 0;
-        if (insertContact.next())
-            contactId = insertContact.value(0).toLongLong();
-
-        for (const auto &ph : c.phoneNumbers())
-        {
-            int type = 1;
-            if (ph.type() == PhoneType::Work)
-                type = 0;
-            else if (ph.type() == PhoneType::Service)
-                type = 2;
+        contacts.bind(upsertContacts);
+        if (!execOrFail(upsertContacts, lastError_, "upsert contacts"))
+            return false;
 
-            insertPhone.bindValue(0, contactId);
-            insertPhone.bindValue(1, type);
-            insertPhone.bindValue(2, ph.value());
+        deletePhones.bindValue(0, ids.literal());
+        if (!execOrFail(deletePhones, lastError_, "delete phones"))
+            return false;
 
-            if (!insertPhone.exec())
-            {
-                lastError_ = insertPhone.lastError().text();
-                database.rollback();
-                qCWarning(logDb) << "insert phone failed:" << lastError_;
-                return;
-            }
-        }
-    }
+        if (phones.size == 0)
+            return true;
+        phones.bind(insertPhones);
+        return execOrFail(insertPhones, lastError_, "insert phones"); });
+    if (!upsertedOk)
+        return rollback();
 
     if (!database.commit())
     {
         lastError_ = database.lastError().text();
-        database.rollback();
         qCWarning(logDb) << "commit failed:" << lastError_;
-        return;
+        return rollback();
+    }
+
+    if (snapshotValid_)
+    {
+        for (const qint64 id : deletes)
+            snapshot_.remove(id);
+        for (const Contact *c : upserts)
+            snapshot_.insert(c->id(), RowDigest{contactFieldsDigest(*c), phonesDigest(c->phoneNumbers())});
     }
 
-    qCInfo(logDb) << "saveAll OK. contacts:" << contacts.size();
+    qCInfo(logDb) << "applyChanges OK. upserted:" << upserts.size() << "deleted:" << deletes.size();
 }
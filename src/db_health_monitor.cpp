@@ -0,0 +1,135 @@
+#include "db_health_monitor.hpp"
+
+#include <QLoggingCategory>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+#include <QUuid>
+
+#include <algorithm>
+
+Q_DECLARE_LOGGING_CATEGORY(logDb)
+
+DbHealthMonitor::DbHealthMonitor(DbConfig config, QObject *parent)
+    : QObject(parent),
+      config_(std::move(config)),
+      connectionName_("probe-" + QUuid::createUuid().toString(QUuid::WithoutBraces)),
+      context_(new QObject),
+      timer_(new QTimer(context_))
+{
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, context_, [this]
+            { probe(); });
+
+    thread_.setObjectName("phonebook-db-health");
+    context_->moveToThread(&thread_);
+}
+
+DbHealthMonitor::~DbHealthMonitor()
+{
+    stop();
+    delete context_;
+}
+
+void DbHealthMonitor::setIntervals(int minBackoffMs, int maxBackoffMs, int onlineIntervalMs)
+{
+    minBackoffMs_ = qMax(1, minBackoffMs);
+    maxBackoffMs_ = qMax(minBackoffMs_, maxBackoffMs);
+    onlineIntervalMs_ = qMax(1, onlineIntervalMs);
+}
+
+void DbHealthMonitor::start()
+{
+    if (thread_.isRunning())
+        return;
+
+    backoffMs_ = minBackoffMs_;
+    thread_.start();
+    QMetaObject::invokeMethod(
+        context_, [this]
+        { timer_->start(backoffMs_); },
+        Qt::QueuedConnection);
+}
+
+void DbHealthMonitor::stop()
+{
+    if (!thread_.isRunning())
+        return;
+
+    QMetaObject::invokeMethod(
+        context_, [this]
+        {
+            timer_->stop();
+            closeConnection();
+            thread_.quit(); },
+        Qt::QueuedConnection);
+    thread_.wait();
+}
+
+void DbHealthMonitor::probe()
+{
+    QString error;
+    {
+        QSqlDatabase db = QSqlDatabase::contains(connectionName_)
+                              ? QSqlDatabase::database(connectionName_, false)
+                              : QSqlDatabase::addDatabase("QPSQL", connectionName_);
+        if (!db.isOpen())
+        {
+            db.setHostName(config_.host);
+            db.setPort(config_.port);
+            db.setDatabaseName(config_.name);
+            db.setUserName(config_.user);
+            db.setPassword(config_.password);
+            db.setConnectOptions("connect_timeout=2");
+            if (!db.open())
+                error = db.lastError().text();
+        }
+
+        if (error.isEmpty())
+        {
+            QSqlQuery q(db);
+            if (!q.exec("SELECT 1;"))
+            {
+                error = q.lastError().text();
+                db.close();
+            }
+        }
+    }
+
+    if (error.isEmpty())
+    {
+        backoffMs_ = minBackoffMs_;
+        if (!online_)
+        {
+            online_ = true;
+            qCInfo(logDb) << "Health probe: DB reachable";
+            emit healthChanged(true, QString());
+        }
+        timer_->start(onlineIntervalMs_);
+        return;
+    }
+
+    if (online_)
+    {
+        online_ = false;
+        backoffMs_ = minBackoffMs_;
+        qCWarning(logDb) << "Health probe: DB lost:" << error;
+        emit healthChanged(false, error.trimmed());
+    }
+    else
+    {
+        backoffMs_ = std::min(maxBackoffMs_, backoffMs_ * 2);
+    }
+
+    timer_->start(backoffMs_);
+}
+
+void DbHealthMonitor::closeConnection()
+{
+    if (!QSqlDatabase::contains(connectionName_))
+        return;
+
+    QSqlDatabase::database(connectionName_, false).close();
+    QSqlDatabase::removeDatabase(connectionName_);
+}
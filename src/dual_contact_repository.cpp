@@ -0,0 +1,297 @@
+#include "dual_contact_repository.hpp"
+
+#include <QHash>
+#include <QLoggingCategory>
+#include <QSet>
+
+#include <algorithm>
+#include <iterator>
+
+Q_DECLARE_LOGGING_CATEGORY(logDb)
+
+namespace
+{
+    constexpr int kRetryBaseMs = 500;
+    constexpr int kRetryMaxMs = 60 * 1000;
+    constexpr int kLoadBatchSize = 2000;
+    constexpr int kMaxChangeFailures = 3;
+
+    void applyQueued(std::vector<Contact> &batch, QHash<qint64, ContactChange> &queued)
+    {
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            const auto it = queued.find(batch[i].id());
+            if (it != queued.end())
+            {
+                if (it->kind == ContactChange::Kind::Remove)
+                {
+                    queued.erase(it);
+                    continue;
+                }
+                batch[i] = std::move(it->contact);
+                queued.erase(it);
+            }
+            if (out != i)
+                batch[out] = std::move(batch[i]);
+            ++out;
+        }
+        batch.resize(out);
+    }
+}
+
+DualContactRepository::DualContactRepository(DbContactRepository &db, FileContactRepository &file)
+    : db_(db), file_(file)
+{
+    hasPending_ = file_.hasOutbox();
+}
+
+void DualContactRepository::setDbOnline(bool online)
+{
+    dbOnline_ = online;
+    if (online)
+        failedAttempts_ = 0;
+}
+
+bool DualContactRepository::dbOnline() const
+{
+    return dbOnline_;
+}
+
+std::vector<Contact> DualContactRepository::loadAll()
+{
+    return loadStreamed(BatchSink());
+}
+
+std::vector<Contact> DualContactRepository::loadStreamed(const BatchSink &sink)
+{
+    lastError_.clear();
+
+    if (!dbOnline_)
+        return loadFile(sink);
+
+    QHash<qint64, ContactChange> queued;
+    hasPending_ = file_.hasOutbox();
+    if (hasPending_)
+    {
+        quint64 upTo = 0;
+        std::vector<ContactChange> changes = file_.readOutbox(upTo);
+        const QString queueErr = file_.lastError().trimmed();
+        if (!queueErr.isEmpty())
+        {
+            qCWarning(logDb) << "cannot merge the DB outbox, using the file:" << queueErr;
+            return loadFile(sink);
+        }
+
+        qCInfo(logDb) << "merging" << changes.size() << "queued changes over DB rows";
+        queued.reserve(static_cast<int>(changes.size()));
+        for (ContactChange &change : changes)
+            queued.insert(change.id, std::move(change));
+    }
+
+    std::vector<Contact> data;
+    bool first = true;
+    db_.loadBatched(kLoadBatchSize, [&](std::vector<Contact> &&batch)
+                    {
+        applyQueued(batch, queued);
+        if (sink)
+            sink(batch, first);
+        first = false;
+        std::move(batch.begin(), batch.end(), std::back_inserter(data));
+        return true; });
+
+    const QString dbErr = db_.lastError().trimmed();
+    if (!dbErr.isEmpty())
+    {
+        auto fallback = loadFile(sink);
+        const QString fileErr = lastError_;
+        lastError_ = "DB load failed: " + dbErr;
+        if (!fileErr.isEmpty())
+            lastError_ += " | " + fileErr;
+        return fallback;
+    }
+
+    std::vector<Contact> added;
+    for (auto it = queued.begin(); it != queued.end(); ++it)
+    {
+        if (it->kind == ContactChange::Kind::Upsert)
+            added.push_back(std::move(it->contact));
+    }
+    if (sink && (first || !added.empty()))
+        sink(added, first);
+    std::move(added.begin(), added.end(), std::back_inserter(data));
+    qCInfo(logDb) << "loadAll OK. contacts:" << data.size();
+
+    file_.saveAll(data);
+    const QString fileErr = file_.lastError().trimmed();
+    if (!fileErr.isEmpty())
+        lastError_ = "File sync after DB load failed: " + fileErr;
+
+    return data;
+}
+
+std::vector<Contact> DualContactRepository::loadFile(const BatchSink &sink)
+{
+    auto data = file_.loadAll();
+    const QString fileErr = file_.lastError().trimmed();
+    if (!fileErr.isEmpty())
+        lastError_ = "File load failed: " + fileErr;
+
+    hasPending_ = file_.hasOutbox();
+    if (sink)
+        sink(data, true);
+    return data;
+}
+
+void DualContactRepository::saveAll(const std::vector<Contact> &contacts)
+{
+    lastError_.clear();
+
+    const std::vector<Contact> current = file_.loadAll();
+    const QString loadErr = file_.lastError().trimmed();
+    if (!loadErr.isEmpty())
+    {
+        lastError_ = "File load failed: " + loadErr;
+        return;
+    }
+
+    QHash<qint64, quint64> digestOf;
+    digestOf.reserve(static_cast<int>(current.size()));
+    for (const Contact &c : current)
+        digestOf.insert(c.id(), contactDigest(c));
+
+    std::vector<ContactChange> changes;
+    for (const Contact &c : contacts)
+    {
+        const auto it = digestOf.find(c.id());
+        if (it == digestOf.end() || it.value() != contactDigest(c))
+            changes.push_back(ContactChange::upsert(c));
+        if (it != digestOf.end())
+            digestOf.erase(it);
+    }
+    for (auto it = digestOf.constBegin(); it != digestOf.constEnd(); ++it)
+        changes.push_back(ContactChange::remove(it.key()));
+
+    file_.saveAll(contacts);
+    const QString fileErr = file_.lastError().trimmed();
+    if (!fileErr.isEmpty())
+    {
+        lastError_ = "File save failed: " + fileErr;
+        return;
+    }
+
+    if (changes.empty())
+        return;
+
+    if (!file_.enqueueForDb(changes))
+        lastError_ = "DB outbox write failed: " + file_.lastError().trimmed();
+    hasPending_ = true;
+}
+
+QFuture<QString> DualContactRepository::saveChanges(std::vector<ContactChange> changes)
+{
+    hasPending_ = true;
+    return file_.applyChanges(std::move(changes), true);
+}
+
+QFuture<QString> DualContactRepository::applyRemote(std::vector<ContactChange> changes)
+{
+    return file_.applyChanges(std::move(changes));
+}
+
+bool DualContactRepository::hasPendingSync() const
+{
+    return hasPending_;
+}
+
+bool DualContactRepository::syncPending()
+{
+    syncedChanges_ = 0;
+    if (!hasPending_)
+        return true;
+    if (!dbOnline_)
+        return false;
+
+    quint64 upTo = 0;
+    const std::vector<ContactChange> changes = file_.readOutbox(upTo);
+    const QString queueErr = file_.lastError().trimmed();
+    if (!queueErr.isEmpty())
+    {
+        ++failedAttempts_;
+        qCWarning(logDb) << "write-behind sync cannot read the outbox, attempt" << failedAttempts_ << ":" << queueErr;
+        return false;
+    }
+
+    if (!changes.empty())
+    {
+        db_.applyChanges(changes);
+        const QString dbErr = db_.lastError().trimmed();
+        if (!dbErr.isEmpty())
+        {
+            ++failedAttempts_;
+            qCWarning(logDb) << "write-behind sync failed, attempt" << failedAttempts_ << ":" << dbErr;
+            if (!db_.lastErrorIsConnection())
+                rejectFailingChanges(changes, upTo);
+            return false;
+        }
+    }
+
+    if (!file_.ackOutbox(upTo))
+    {
+        ++failedAttempts_;
+        qCWarning(logDb) << "write-behind ack failed:" << file_.lastError();
+        return false;
+    }
+
+    qCInfo(logDb) << "write-behind sync OK. changes:" << changes.size();
+    hasPending_ = file_.hasOutbox();
+    failedAttempts_ = 0;
+    syncedChanges_ = changes.size();
+    changeFailures_.clear();
+    return true;
+}
+
+void DualContactRepository::rejectFailingChanges(const std::vector<ContactChange> &changes, quint64 upToSeq)
+{
+    QSet<qint64> rejected;
+    for (const ContactChange &change : changes)
+    {
+        db_.applyChanges({change});
+        if (db_.lastError().trimmed().isEmpty())
+        {
+            changeFailures_.remove(change.id);
+            continue;
+        }
+        if (db_.lastErrorIsConnection())
+            return;
+
+        if (++changeFailures_[change.id] >= kMaxChangeFailures)
+            rejected.insert(change.id);
+    }
+
+    if (rejected.isEmpty())
+        return;
+
+    if (!file_.rejectOutbox(rejected, upToSeq))
+    {
+        qCWarning(logDb) << "cannot move failing changes out of the DB outbox:" << file_.lastError();
+        return;
+    }
+
+    for (const qint64 id : rejected)
+        changeFailures_.remove(id);
+    qCWarning(logDb) << rejected.size() << "queued changes keep failing in the DB and were moved to"
+                     << file_.rejectedOutboxPath();
+    hasPending_ = file_.hasOutbox();
+    failedAttempts_ = 0;
+}
+std::size_t DualContactRepository::syncedChanges() const
+{
+    return syncedChanges_;
+}
+
+int DualContactRepository::retryDelayMs() const
+{
+    const int shift = std::min(failedAttempts_, 16);
+    return std::min(kRetryMaxMs, kRetryBaseMs << shift);
+}
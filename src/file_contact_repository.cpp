@@ -1,216 +1,1381 @@
 #include "file_contact_repository.hpp"
 
+#include <QElapsedTimer>
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
 
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+#include <cstring>
+#include <iterator>
+
+#include "binary_snapshot.hpp"
 #include "phone_number.hpp"
+#include "text_scanner.hpp"
+
+Q_LOGGING_CATEGORY(logFile, "phonebook.file")
 
 namespace
 {
-    QString escapeField(const QString &value)
+    constexpr qint64 kParallelLoadThreshold = 256 * 1024;
+    constexpr int kChunksPerThread = 4;
+    constexpr int kMinCompactionRecords = 64;
+    constexpr char kSeqHeader[] = "#seq ";
+
+    struct LoadChunk
+    {
+        const char *begin{nullptr};
+        const char *end{nullptr};
+        std::vector<Contact> contacts;
+    };
+
+    QDate parseDate(const FieldRange &field)
     {
-        QString out;
-        out.reserve(value.size());
-        for (const QChar ch : value)
+        const char *p = field.begin;
+        const auto digit = [](char ch)
+        { return ch >= '0' && ch <= '9'; };
+
+        if (!field.escaped && field.end - p == 10 && p[2] == '.' && p[5] == '.' &&
+            digit(p[0]) && digit(p[1]) && digit(p[3]) && digit(p[4]) &&
+            digit(p[6]) && digit(p[7]) && digit(p[8]) && digit(p[9]))
         {
-            if (ch == '|' || ch == ',' || ch == '\\' || ch == '\n')
-                out.append('\\');
-            out.append(ch);
+            const int day = (p[0] - '0') * 10 + (p[1] - '0');
+            const int month = (p[3] - '0') * 10 + (p[4] - '0');
+            const int year = (p[6] - '0') * 1000 + (p[7] - '0') * 100 + (p[8] - '0') * 10 + (p[9] - '0');
+            return QDate(year, month, day);
         }
-        return out;
+
+        const QString s = decodeField(field).trimmed();
+        if (s.isEmpty())
+            return QDate();
+        return QDate::fromString(s, "dd.MM.yyyy");
     }
 
-    QString unescapeField(const QString &value)
+    std::vector<PhoneNumber> parsePhones(const FieldRange &field)
     {
-        QString out;
-        out.reserve(value.size());
-        bool esc = false;
-        for (const QChar ch : value)
+        std::vector<PhoneNumber> phones;
+
+        const char *p = field.begin;
+        while (true)
         {
-            if (!esc && ch == '\\')
+            FieldRange item;
+            const char *stop = scanField(p, field.end, ',', item);
+
+            if (item.begin != item.end)
             {
-                esc = true;
-                continue;
+                FieldRange type;
+                FieldRange number;
+                const char *colon = scanField(item.begin, item.end, ':', type);
+                if (colon < item.end && scanField(colon + 1, item.end, ':', number) == item.end)
+                    phones.emplace_back(PhoneNumber::stringToType(decodeField(type)), decodeField(number));
             }
-            out.append(ch);
-            esc = false;
+
+            if (stop >= field.end)
+                break;
+            p = stop + 1;
         }
-        return out;
+
+        return phones;
     }
 
-    std::vector<QString> splitEscaped(const QString &line, QChar delimiter)
+    QByteArray serializeContact(const Contact &c)
     {
-        std::vector<QString> parts;
-        QString cur;
-        bool esc = false;
+        QByteArray out;
+        out.reserve(160);
+
+        appendEscaped(out, c.firstName());
+        out += '|';
+        appendEscaped(out, c.lastName());
+        out += '|';
+        appendEscaped(out, c.middleName());
+        out += '|';
+        appendEscaped(out, c.address());
+        out += '|';
+        if (c.birthDate().isValid())
+            out += c.birthDate().toString("dd.MM.yyyy").toLatin1();
+        out += '|';
+        appendEscaped(out, c.email());
+        out += '|';
+
+        const auto &phones = c.phoneNumbers();
+        for (std::size_t i = 0; i < phones.size(); ++i)
+        {
+            if (i > 0)
+                out += ',';
+            out += PhoneNumber::typeToString(phones[i].type()).toLatin1();
+            out += ':';
+            appendEscaped(out, phones[i].value());
+        }
 
-        for (const QChar ch : line)
+        if (c.id() != 0)
         {
-            if (!esc && ch == '\\')
+            out += '|';
+            out += QByteArray::number(c.id());
+        }
+        return out;
+    }
+
+    bool deserializeContact(const char *begin, const char *end, Contact &outContact)
+    {
+        FieldRange fields[7];
+        const char *p = begin;
+        for (int i = 0; i < 7; ++i)
+        {
+            if (i > 0)
             {
-                esc = true;
-                continue;
+                if (p >= end)
+                    return false;
+                ++p;
             }
+            p = scanField(p, end, '|', fields[i]);
+        }
+
+        Contact c;
+        if (p < end)
+        {
+            FieldRange idField;
+            scanField(p + 1, end, '|', idField);
+            c.setId(QByteArray(idField.begin, static_cast<int>(idField.end - idField.begin)).toLongLong());
+        }
+        c.setFirstName(decodeField(fields[0]).trimmed());
+        c.setLastName(decodeField(fields[1]).trimmed());
+        c.setMiddleName(decodeField(fields[2]).trimmed());
+        c.setAddress(decodeField(fields[3]).trimmed());
+        c.setBirthDate(parseDate(fields[4]));
+        c.setEmail(decodeField(fields[5]).trimmed());
+        c.setPhoneNumbers(parsePhones(fields[6]));
+
+        if (c.firstName().isEmpty() || c.lastName().isEmpty() || c.email().isEmpty() || c.phoneNumbers().empty())
+            return false;
+
+        outContact = std::move(c);
+        return true;
+    }
+
+    bool isBlank(const char *begin, const char *end)
+    {
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\f' && *p != '\v')
+                return false;
+        }
+        return true;
+    }
+
+    bool isEscapedAt(const char *begin, const char *pos)
+    {
+        int slashes = 0;
+        while (pos > begin && *(pos - 1) == '\\')
+        {
+            ++slashes;
+            --pos;
+        }
+        return (slashes % 2) != 0;
+    }
+
+    const char *findRecordEnd(const char *begin, const char *from, const char *end)
+    {
+        const char *pos = from;
+        while (pos < end)
+        {
+            pos = static_cast<const char *>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+            if (!pos)
+                return end;
+            if (!isEscapedAt(begin, pos))
+                return pos;
+            ++pos;
+        }
+        return end;
+    }
 
-            if (!esc && ch == delimiter)
+    void parseChunk(LoadChunk &chunk)
+    {
+        const char *pos = chunk.begin;
+        while (pos < chunk.end)
+        {
+            const char *lineEnd = findRecordEnd(chunk.begin, pos, chunk.end);
+            const char *contentEnd = lineEnd;
+            if (contentEnd > pos && *(contentEnd - 1) == '\r')
+                --contentEnd;
+
+            if (!isBlank(pos, contentEnd))
             {
-                parts.push_back(cur);
-                cur.clear();
-                continue;
+                Contact c;
+                if (deserializeContact(pos, contentEnd, c))
+                    chunk.contacts.push_back(std::move(c));
             }
 
-            cur.append(ch);
-            esc = false;
+            if (lineEnd == chunk.end)
+                break;
+            pos = lineEnd + 1;
+        }
+    }
+
+    std::vector<LoadChunk> splitIntoChunks(const char *begin, const char *end, int chunkCount)
+    {
+        std::vector<LoadChunk> chunks;
+        const qint64 size = end - begin;
+        const qint64 target = qMax<qint64>(1, size / qMax(1, chunkCount));
+
+        const char *pos = begin;
+        while (pos < end)
+        {
+            const char *cut = (end - pos > target) ? findRecordEnd(begin, pos + target, end) : end;
+            if (cut < end)
+                ++cut;
+
+            LoadChunk chunk;
+            chunk.begin = pos;
+            chunk.end = cut;
+            chunks.push_back(std::move(chunk));
+            pos = cut;
         }
+        return chunks;
+    }
 
-        parts.push_back(cur);
-        return parts;
+    bool syncFile(QFileDevice &file)
+    {
+        if (!file.flush())
+            return false;
+#if defined(Q_OS_UNIX)
+        return ::fsync(file.handle()) == 0;
+#elif defined(Q_OS_WIN)
+        return ::_commit(file.handle()) == 0;
+#else
+        return true;
+#endif
     }
 
-    QString serializePhones(const std::vector<PhoneNumber> &phones)
+    void syncDirectoryOf(const QString &path)
     {
-        QString out;
-        for (std::size_t i = 0; i < phones.size(); ++i)
+#if defined(Q_OS_UNIX)
+        const QByteArray dir = QFile::encodeName(QFileInfo(path).absolutePath());
+        const int fd = ::open(dir.constData(), O_RDONLY);
+        if (fd >= 0)
         {
-            const auto &p = phones[i];
-            out += PhoneNumber::typeToString(p.type());
-            out += ':';
-            out += escapeField(p.value());
-            if (i + 1 < phones.size())
-                out += ',';
+            ::fsync(fd);
+            ::close(fd);
         }
-        return out;
+#else
+        Q_UNUSED(path);
+#endif
     }
 
-    std::vector<PhoneNumber> deserializePhones(const QString &value)
+    bool writeTextSnapshot(const QString &path, const std::vector<Contact> &contacts, quint64 seq, QString &error)
     {
-        std::vector<PhoneNumber> phones;
-        const auto items = splitEscaped(value, ',');
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
 
-        for (const auto &item : items)
+        if (seq > 0)
         {
-            if (item.isEmpty())
-                continue;
+            QByteArray header(kSeqHeader);
+            header += QByteArray::number(seq);
+            header += '\n';
+            file.write(header);
+        }
 
-            const auto pair = splitEscaped(item, ':');
-            if (pair.size() != 2)
-                continue;
+        for (const auto &c : contacts)
+        {
+            QByteArray line = serializeContact(c);
+            line += '\n';
+            file.write(line);
+        }
 
-            const PhoneType type = PhoneNumber::stringToType(pair[0]);
-            const QString number = unescapeField(pair[1]);
-            phones.emplace_back(type, number);
+        if (!file.commit())
+        {
+            error = file.errorString();
+            return false;
         }
+        return true;
+    }
 
-        return phones;
+    bool writeSnapshot(const QString &path, FileContactRepository::Format format,
+                       const std::vector<Contact> &contacts, quint64 seq, QString &error)
+    {
+        const bool ok = (format == FileContactRepository::Format::Text)
+                            ? writeTextSnapshot(path, contacts, seq, error)
+                            : writeBinarySnapshot(path, contacts, seq, &error);
+        if (!ok)
+        {
+            qCWarning(logFile) << "snapshot write failed:" << path << error;
+            return false;
+        }
+
+        syncDirectoryOf(path);
+        return true;
     }
 
-    QString dateToString(const QDate &date)
+    bool readTextSnapshot(const QString &path, std::vector<Contact> &contacts, quint64 &seq, QString &error)
     {
-        if (!date.isValid())
-            return QString();
-        return date.toString("dd.MM.yyyy");
+        QFile file(path);
+        if (!file.exists())
+            return true;
+
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        const qint64 size = file.size();
+        if (size <= 0)
+            return true;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QByteArray buffer;
+        const char *begin = nullptr;
+        uchar *mapped = file.map(0, size);
+        if (mapped)
+        {
+            begin = reinterpret_cast<const char *>(mapped);
+        }
+        else
+        {
+            buffer = file.readAll();
+            begin = buffer.constData();
+        }
+        const char *end = begin + (mapped ? size : buffer.size());
+
+        if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+            begin += 3;
+
+        const std::size_t headerSize = sizeof(kSeqHeader) - 1;
+        if (static_cast<std::size_t>(end - begin) > headerSize && std::memcmp(begin, kSeqHeader, headerSize) == 0)
+        {
+            const char *lineEnd = findRecordEnd(begin, begin, end);
+            seq = QByteArray(begin + headerSize, static_cast<int>(lineEnd - begin - headerSize)).trimmed().toULongLong();
+            begin = (lineEnd < end) ? lineEnd + 1 : end;
+        }
+
+        const int threads = QThreadPool::globalInstance()->maxThreadCount();
+        const int chunkCount = (size < kParallelLoadThreshold) ? 1 : threads * kChunksPerThread;
+        std::vector<LoadChunk> chunks = splitIntoChunks(begin, end, chunkCount);
+
+        if (chunks.size() == 1)
+            parseChunk(chunks.front());
+        else
+            QtConcurrent::blockingMap(chunks, parseChunk);
+
+        std::size_t total = 0;
+        for (const auto &chunk : chunks)
+            total += chunk.contacts.size();
+
+        contacts.reserve(total);
+        for (auto &chunk : chunks)
+            std::move(chunk.contacts.begin(), chunk.contacts.end(), std::back_inserter(contacts));
+
+        if (mapped)
+            file.unmap(mapped);
+
+        const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+        qCInfo(logFile) << "loadSnapshot OK. contacts:" << contacts.size()
+                        << "chunks:" << chunks.size()
+                        << "MB/s:" << (size / (1024.0 * 1024.0)) / seconds
+                        << "contacts/s:" << contacts.size() / seconds;
+        return true;
     }
 
-    QDate dateFromString(const QString &value)
+    bool readSnapshot(const QString &path, FileContactRepository::Format format,
+                      std::vector<Contact> &contacts, quint64 &seq, QString &error)
     {
-        const QString s = value.trimmed();
-        if (s.isEmpty())
-            return QDate();
-        return QDate::fromString(s, "dd.MM.yyyy");
+        contacts.clear();
+        seq = 0;
+
+        if (format == FileContactRepository::Format::Text)
+            return readTextSnapshot(path, contacts, seq, error);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        if (!readBinarySnapshot(path, contacts, seq, &error))
+        {
+            qCWarning(logFile) << "binary snapshot load failed:" << error;
+            contacts.clear();
+            return false;
+        }
+        qCInfo(logFile) << "loadSnapshot OK. contacts:" << contacts.size() << "ms:" << timer.elapsed();
+        return true;
     }
 
-    QString serializeContact(const Contact &c)
+    QByteArray journalRecord(quint64 seq, char op, qint64 key, const Contact *contact)
     {
-        QString out;
-        out += escapeField(c.firstName());
-        out += '|';
-        out += escapeField(c.lastName());
-        out += '|';
-        out += escapeField(c.middleName());
-        out += '|';
-        out += escapeField(c.address());
-        out += '|';
-        out += escapeField(dateToString(c.birthDate()));
+        QByteArray out = QByteArray::number(seq);
         out += '|';
-        out += escapeField(c.email());
+        out += op;
         out += '|';
-        out += serializePhones(c.phoneNumbers());
+        out += QByteArray::number(key);
+        if (contact)
+        {
+            out += '|';
+            out += serializeContact(*contact);
+        }
+        out += '\n';
         return out;
     }
 
-    bool deserializeContact(const QString &line, Contact &outContact)
+    QByteArray changeRecord(quint64 seq, const ContactChange &change)
+    {
+        if (change.kind == ContactChange::Kind::Remove)
+            return journalRecord(seq, 'R', change.id, nullptr);
+        return journalRecord(seq, 'S', change.id, &change.contact);
+    }
+
+    struct JournalRecord
+    {
+        quint64 seq{0};
+        char op{0};
+        qint64 key{0};
+        Contact contact;
+    };
+
+    bool parseJournalRecord(const char *begin, const char *end, JournalRecord &record)
     {
-        const auto fields = splitEscaped(line, '|');
-        if (fields.size() < 7)
+        const auto next = [end](const char *from)
+        {
+            const void *hit = std::memchr(from, '|', static_cast<std::size_t>(end - from));
+            return hit ? static_cast<const char *>(hit) : end;
+        };
+
+        const char *seqEnd = next(begin);
+        if (seqEnd == end)
             return false;
+        const char *opEnd = next(seqEnd + 1);
+        if (opEnd == end || opEnd - seqEnd != 2)
+            return false;
+        const char *keyEnd = next(opEnd + 1);
 
-        Contact c;
-        c.setFirstName(unescapeField(fields[0]).trimmed());
-        c.setLastName(unescapeField(fields[1]).trimmed());
-        c.setMiddleName(unescapeField(fields[2]).trimmed());
-        c.setAddress(unescapeField(fields[3]).trimmed());
-        c.setBirthDate(dateFromString(unescapeField(fields[4])));
-        c.setEmail(unescapeField(fields[5]).trimmed());
-        c.setPhoneNumbers(deserializePhones(fields[6]));
+        bool ok = false;
+        record.seq = QByteArray(begin, static_cast<int>(seqEnd - begin)).toULongLong(&ok);
+        if (!ok)
+            return false;
 
-        if (c.firstName().isEmpty() || c.lastName().isEmpty() || c.email().isEmpty() || c.phoneNumbers().empty())
+        record.key = QByteArray(opEnd + 1, static_cast<int>(keyEnd - opEnd - 1)).toLongLong(&ok);
+        if (!ok)
             return false;
 
-        outContact = std::move(c);
+        record.op = seqEnd[1];
+        switch (record.op)
+        {
+        case 'D':
+        case 'R':
+            return keyEnd == end;
+        case 'I':
+        case 'U':
+        case 'S':
+            if (keyEnd == end || !deserializeContact(keyEnd + 1, end, record.contact))
+                return false;
+            if (record.op == 'S')
+                record.contact.setId(record.key);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    class JournalReplay
+    {
+    public:
+        explicit JournalReplay(std::vector<Contact> &contacts)
+            : contacts_(contacts), dead_(contacts.size(), 0)
+        {
+        }
+
+        bool apply(JournalRecord &&record)
+        {
+            const std::size_t row = static_cast<std::size_t>(record.key);
+            switch (record.op)
+            {
+            case 'S':
+                upsert(std::move(record.contact));
+                return true;
+            case 'R':
+                remove(record.key);
+                return true;
+            case 'I':
+                compact();
+                if (record.key < 0 || row > contacts_.size())
+                    return false;
+                contacts_.insert(contacts_.begin() + static_cast<std::ptrdiff_t>(row), std::move(record.contact));
+                dead_.push_back(0);
+                indexed_ = false;
+                return true;
+            case 'U':
+                compact();
+                if (record.key < 0 || row >= contacts_.size())
+                    return false;
+                contacts_[row] = std::move(record.contact);
+                indexed_ = false;
+                return true;
+            case 'D':
+                compact();
+                if (record.key < 0 || row >= contacts_.size())
+                    return false;
+                contacts_.erase(contacts_.begin() + static_cast<std::ptrdiff_t>(row));
+                dead_.pop_back();
+                indexed_ = false;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        void upsert(Contact contact)
+        {
+            index();
+            const auto it = rowOf_.constFind(contact.id());
+            if (it != rowOf_.constEnd())
+            {
+                contacts_[it.value()] = std::move(contact);
+                return;
+            }
+
+            rowOf_.insert(contact.id(), contacts_.size());
+            contacts_.push_back(std::move(contact));
+            dead_.push_back(0);
+        }
+
+        void remove(qint64 id)
+        {
+            index();
+            const auto it = rowOf_.find(id);
+            if (it == rowOf_.end())
+                return;
+
+            dead_[it.value()] = 1;
+            ++removed_;
+            rowOf_.erase(it);
+        }
+
+        void finish()
+        {
+            compact();
+        }
+
+    private:
+        std::vector<Contact> &contacts_;
+        std::vector<char> dead_;
+        QHash<qint64, std::size_t> rowOf_;
+        bool indexed_{false};
+        std::size_t removed_{0};
+
+        void index()
+        {
+            if (indexed_)
+                return;
+
+            rowOf_.clear();
+            rowOf_.reserve(static_cast<int>(contacts_.size()));
+            for (std::size_t i = 0; i < contacts_.size(); ++i)
+            {
+                if (!dead_[i] && contacts_[i].id() != 0)
+                    rowOf_.insert(contacts_[i].id(), i);
+            }
+            indexed_ = true;
+        }
+
+        void compact()
+        {
+            if (removed_ == 0)
+                return;
+
+            std::size_t out = 0;
+            for (std::size_t i = 0; i < contacts_.size(); ++i)
+            {
+                if (dead_[i])
+                    continue;
+                if (out != i)
+                    contacts_[out] = std::move(contacts_[i]);
+                ++out;
+            }
+            contacts_.resize(out);
+            dead_.assign(out, 0);
+            removed_ = 0;
+            indexed_ = false;
+        }
+    };
+
+    enum class LogStatus
+    {
+        Ok,
+        TornTail,
+        Corrupt
+    };
+
+    template <typename Fn>
+    LogStatus readLog(const QByteArray &data, qint64 &validBytes, int &records, Fn apply)
+    {
+        const char *begin = data.constData();
+        const char *end = begin + data.size();
+        const char *pos = begin;
+
+        while (pos < end)
+        {
+            const char *lineEnd = findRecordEnd(begin, pos, end);
+            if (lineEnd == end)
+                break;
+
+            JournalRecord record;
+            if (!parseJournalRecord(pos, lineEnd, record) || !apply(std::move(record)))
+            {
+                if (!isBlank(lineEnd + 1, end))
+                {
+                    validBytes = pos - begin;
+                    return LogStatus::Corrupt;
+                }
+                break;
+            }
+
+            ++records;
+            pos = lineEnd + 1;
+        }
+
+        validBytes = pos - begin;
+        return validBytes < data.size() ? LogStatus::TornTail : LogStatus::Ok;
+    }
+
+    bool appendRecords(const QString &path, const QByteArray &records, QString &error)
+    {
+        QFile journal(path);
+        if (!journal.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            error = journal.errorString();
+            return false;
+        }
+
+        const qint64 before = journal.size();
+        if (journal.write(records) != records.size() || !syncFile(journal))
+        {
+            error = journal.errorString();
+            qCWarning(logFile) << "journal append failed:" << path << error;
+            journal.close();
+            QFile::resize(path, before);
+            return false;
+        }
         return true;
     }
+
+    bool replayJournalFile(const QString &path, quint64 baseSeq, JournalReplay &replay,
+                           quint64 &seq, qint64 &bytes, int &records, QString &error)
+    {
+        QFile file(path);
+        if (!file.exists())
+            return true;
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            error = file.errorString();
+            return false;
+        }
+
+        const QByteArray data = file.readAll();
+        file.close();
+
+        qint64 valid = 0;
+        int applied = 0;
+        const LogStatus status = readLog(data, valid, applied, [baseSeq, &replay, &seq](JournalRecord &&record)
+                                         {
+            if (record.seq <= baseSeq)
+                return true;
+            const quint64 recordSeq = record.seq;
+            if (!replay.apply(std::move(record)))
+                return false;
+            seq = recordSeq;
+            return true; });
+
+        if (status == LogStatus::Corrupt)
+        {
+            error = QString("journal %1 is corrupt at byte %2").arg(path).arg(valid);
+            return false;
+        }
+
+        if (status == LogStatus::TornTail)
+        {
+            qCWarning(logFile) << "journal" << path << "has a torn final record, truncated at byte" << valid << "of" << data.size();
+            QFile::resize(path, valid);
+        }
+
+        records += applied;
+        bytes += valid;
+        return true;
+    }
+
+    void compactSnapshot(const QString &path, FileContactRepository::Format format, const QString &rotated)
+    {
+        QString error;
+        std::vector<Contact> contacts;
+        quint64 seq = 0;
+        if (!readSnapshot(path, format, contacts, seq, error))
+        {
+            qCWarning(logFile) << "compaction skipped, snapshot unreadable:" << error;
+            return;
+        }
+
+        JournalReplay replay(contacts);
+        qint64 bytes = 0;
+        int records = 0;
+        if (!replayJournalFile(rotated, seq, replay, seq, bytes, records, error))
+        {
+            qCWarning(logFile) << "compaction skipped:" << error;
+            return;
+        }
+        replay.finish();
+
+        if (!writeSnapshot(path, format, contacts, seq, error))
+            return;
+        QFile::remove(rotated);
+        qCInfo(logFile) << "compaction OK. contacts:" << contacts.size() << "seq:" << seq;
+    }
+}
+
+FileContactRepository::FileContactRepository(QString filePath, Format format)
+    : filePath_(std::move(filePath)),
+      format_(format)
+{
+    commitPool_.setMaxThreadCount(1);
+    ioPool_.setMaxThreadCount(1);
+}
+
+FileContactRepository::~FileContactRepository()
+{
+    flush();
+    ioPool_.waitForDone();
+}
+
+void FileContactRepository::setJournaled(bool enabled)
+{
+    QMutexLocker lock(&stateMutex_);
+    journaled_ = enabled;
+    stateValid_ = false;
+}
+
+void FileContactRepository::setCompactionThresholds(qint64 maxJournalBytes, double maxJournalRatio)
+{
+    QMutexLocker lock(&stateMutex_);
+    maxJournalBytes_ = maxJournalBytes;
+    maxJournalRatio_ = maxJournalRatio;
+}
+
+void FileContactRepository::setGroupCommitWindow(int ms)
+{
+    flush();
+    groupCommitWindowMs_ = qMax(0, ms);
+}
+
+QString FileContactRepository::filePath() const
+{
+    return filePath_;
+}
+
+QString FileContactRepository::lastError() const
+{
+    QMutexLocker lock(&statusMutex_);
+    return lastError_;
+}
+
+DurabilityMetrics FileContactRepository::metrics() const
+{
+    QMutexLocker lock(&statusMutex_);
+    return metrics_;
+}
+
+QString FileContactRepository::journalPath() const
+{
+    return filePath_ + ".journal";
 }
 
-FileContactRepository::FileContactRepository(QString filePath)
-    : filePath_(std::move(filePath))
+QString FileContactRepository::rotatedJournalPath() const
 {
+    return filePath_ + ".journal.1";
 }
 
 std::vector<Contact> FileContactRepository::loadAll()
 {
+    flush();
+
+    QMutexLocker lock(&stateMutex_);
+    QString error;
+    std::vector<Contact> contacts = loadLocked(error);
+
+    QMutexLocker status(&statusMutex_);
+    lastError_ = error;
+    return contacts;
+}
+
+std::vector<Contact> FileContactRepository::loadLocked(QString &error)
+{
+    compaction_.waitForFinished();
+
+    stateValid_ = false;
+    digestsValid_ = false;
+    unreadable_ = false;
+
+    quint64 baseSeq = 0;
     std::vector<Contact> contacts;
+    bool ok = readSnapshot(filePath_, format_, contacts, baseSeq, error);
 
-    QFile file(filePath_);
-    if (!file.exists())
-        return contacts;
+    if (ok && journaled_)
+    {
+        seq_ = baseSeq;
+        journalBytes_ = 0;
+        journalRecords_ = 0;
 
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-        return contacts;
+        JournalReplay replay(contacts);
+        ok = replayJournalFile(rotatedJournalPath(), baseSeq, replay, seq_, journalBytes_, journalRecords_, error) &&
+             replayJournalFile(journalPath(), baseSeq, replay, seq_, journalBytes_, journalRecords_, error);
+        replay.finish();
+    }
 
-    QTextStream in(&file);
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    in.setEncoding(QStringConverter::Utf8);
-#else
-    in.setCodec("UTF-8");
-#endif
+    if (!ok)
+    {
+        qCWarning(logFile) << "load failed, saves are refused until the file is readable:" << error;
+        unreadable_ = true;
+        return {};
+    }
 
-    while (!in.atEnd())
+    bool assignedIds = false;
+    for (auto &c : contacts)
     {
-        const QString line = in.readLine();
-        if (line.trimmed().isEmpty())
+        if (c.id() != 0)
             continue;
+        c.setId(Contact::generateId());
+        assignedIds = true;
+    }
 
-        Contact c;
-        if (deserializeContact(line, c))
-            contacts.push_back(std::move(c));
+    contactCount_ = contacts.size();
+    if (!journaled_)
+        return contacts;
+
+    std::vector<quint64> digests;
+    digests.reserve(contacts.size());
+    for (const auto &c : contacts)
+        digests.push_back(contactDigest(c));
+
+    if (assignedIds)
+    {
+        QString writeError;
+        if (!writeFullSnapshot(contacts, std::move(digests), writeError))
+            qCWarning(logFile) << "could not persist assigned contact ids:" << writeError;
+        stateValid_ = true;
+        return contacts;
     }
 
+    digests_ = std::move(digests);
+    digestsValid_ = true;
+    stateValid_ = true;
+
+    maybeCompact();
     return contacts;
 }
 
-void FileContactRepository::saveAll(const std::vector<Contact> &contacts)
+bool FileContactRepository::appendJournal(const std::vector<Contact> &contacts, std::vector<quint64> &digests)
 {
-    QFile file(filePath_);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    const std::size_t oldSize = digests_.size();
+    const std::size_t newSize = digests.size();
+
+    std::size_t first = 0;
+    while (first < oldSize && first < newSize && digests_[first] == digests[first])
+        ++first;
+
+    if (first == oldSize && first == newSize)
+        return true;
+
+    std::size_t oldLast = oldSize;
+    std::size_t newLast = newSize;
+    while (oldLast > first && newLast > first && digests_[oldLast - 1] == digests[newLast - 1])
+    {
+        --oldLast;
+        --newLast;
+    }
+
+    const qint64 row = static_cast<qint64>(first);
+    QByteArray record;
+    if (oldLast - first == 0 && newLast - first == 1)
+        record = journalRecord(seq_ + 1, 'I', row, &contacts[first]);
+    else if (oldLast - first == 1 && newLast - first == 0)
+        record = journalRecord(seq_ + 1, 'D', row, nullptr);
+    else if (oldLast - first == 1 && newLast - first == 1)
+        record = journalRecord(seq_ + 1, 'U', row, &contacts[first]);
+    else
+        return false;
+
+    QString error;
+    if (!appendRecords(journalPath(), record, error))
+        return false;
+
+    ++seq_;
+    ++journalRecords_;
+    journalBytes_ += record.size();
+    digests_ = std::move(digests);
+    contactCount_ = contacts.size();
+    return true;
+}
+
+bool FileContactRepository::writeFullSnapshot(const std::vector<Contact> &contacts, std::vector<quint64> digests, QString &error)
+{
+    compaction_.waitForFinished();
+
+    if (!writeSnapshot(filePath_, format_, contacts, seq_, error))
+    {
+        stateValid_ = false;
+        digestsValid_ = false;
+        return false;
+    }
+
+    QFile::remove(journalPath());
+    QFile::remove(rotatedJournalPath());
+
+    journalBytes_ = 0;
+    journalRecords_ = 0;
+    contactCount_ = contacts.size();
+    digests_ = std::move(digests);
+    digestsValid_ = true;
+    stateValid_ = true;
+    return true;
+}
+
+void FileContactRepository::maybeCompact()
+{
+    if (compaction_.isRunning())
         return;
 
-    QTextStream out(&file);
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    out.setEncoding(QStringConverter::Utf8);
-#else
-    out.setCodec("UTF-8");
-#endif
+    const double ratioLimit = maxJournalRatio_ * static_cast<double>(contactCount_);
+    const bool tooManyRecords = journalRecords_ >= kMinCompactionRecords && journalRecords_ > ratioLimit;
+    if (!tooManyRecords && journalBytes_ < maxJournalBytes_)
+        return;
 
+    const QString rotated = rotatedJournalPath();
+    if (!QFile::exists(rotated))
+    {
+        if (!QFile::rename(journalPath(), rotated))
+            return;
+        journalBytes_ = 0;
+        journalRecords_ = 0;
+    }
+
+    const QString path = filePath_;
+    const Format format = format_;
+    compaction_ = QtConcurrent::run(&ioPool_, [path, format, rotated]
+                                    { compactSnapshot(path, format, rotated); });
+}
+
+bool FileContactRepository::persist(const std::vector<Contact> &contacts, QString &error)
+{
+    if (unreadable_)
+    {
+        error = "refusing to overwrite " + filePath_ + ": it could not be read on load";
+        return false;
+    }
+
+    if (!journaled_)
+        return writeSnapshot(filePath_, format_, contacts, 0, error);
+
+    std::vector<quint64> digests;
+    digests.reserve(contacts.size());
     for (const auto &c : contacts)
-        out << serializeContact(c) << "\n";
+        digests.push_back(contactDigest(c));
+
+    if (stateValid_ && digestsValid_ && appendJournal(contacts, digests))
+    {
+        maybeCompact();
+        return true;
+    }
+
+    return writeFullSnapshot(contacts, std::move(digests), error);
+}
+
+bool FileContactRepository::persistChanges(const std::vector<ContactChange> &changes,
+                                           const std::vector<ContactChange> &outbox, QString &error)
+{
+    const qint64 outboxBefore = outbox.empty() ? 0 : QFileInfo(outboxPath()).size();
+    if (!appendOutbox(outbox, error))
+        return false;
+
+    if (writeChanges(changes, error))
+        return true;
+
+    if (!outbox.empty())
+    {
+        if (outboxBefore > 0)
+            QFile::resize(outboxPath(), outboxBefore);
+        else
+            QFile::remove(outboxPath());
+        outboxSeqKnown_ = false;
+    }
+    return false;
+}
+
+bool FileContactRepository::writeChanges(const std::vector<ContactChange> &changes, QString &error)
+{
+    if (!journaled_)
+    {
+        std::vector<Contact> contacts = loadLocked(error);
+        if (unreadable_)
+        {
+            error = "refusing to overwrite " + filePath_ + ": " + error;
+            return false;
+        }
+
+        JournalReplay replay(contacts);
+        for (const ContactChange &change : changes)
+        {
+            if (change.kind == ContactChange::Kind::Remove)
+                replay.remove(change.id);
+            else
+                replay.upsert(change.contact);
+        }
+        replay.finish();
+        return writeSnapshot(filePath_, format_, contacts, 0, error);
+    }
+
+    if (!stateValid_)
+        loadLocked(error);
+
+    if (unreadable_)
+    {
+        error = "refusing to write to " + filePath_ + ": it could not be read on load";
+        return false;
+    }
+
+    QByteArray records;
+    quint64 seq = seq_;
+    for (const ContactChange &change : changes)
+        records += changeRecord(++seq, change);
+
+    if (records.isEmpty())
+        return true;
+
+    if (!appendRecords(journalPath(), records, error))
+        return false;
+
+    seq_ = seq;
+    journalRecords_ += static_cast<int>(changes.size());
+    journalBytes_ += records.size();
+    digestsValid_ = false;
+
+    maybeCompact();
+    return true;
+}
+
+void FileContactRepository::recordCommit(bool ok, const QElapsedTimer &since, quint64 saves)
+{
+    const qint64 latency = since.elapsed();
+
+    QMutexLocker status(&statusMutex_);
+    ++metrics_.commits;
+    metrics_.coalescedSaves += saves;
+    metrics_.lastLatencyMs = latency;
+    metrics_.maxLatencyMs = qMax(metrics_.maxLatencyMs, latency);
+    metrics_.totalLatencyMs += latency;
+
+    qCDebug(logFile) << "commit" << (ok ? "OK." : "FAILED.") << "saves:" << saves << "latency ms:" << latency;
+}
+
+QString FileContactRepository::commitChanges(const std::vector<ContactChange> &changes,
+                                             const std::vector<ContactChange> &outbox,
+                                             const QElapsedTimer &since, quint64 saves)
+{
+    QMutexLocker lock(&stateMutex_);
+
+    QString error;
+    const bool ok = persistChanges(changes, outbox, error);
+    recordCommit(ok, since, saves);
+
+    if (ok)
+        return QString();
+    return error.isEmpty() ? QString("write failed: ") + filePath_ : error;
+}
+
+void FileContactRepository::flushPending()
+{
+    std::vector<ContactChange> changes;
+    std::vector<ContactChange> outbox;
+    std::vector<QFutureInterface<QString>> waiters;
+    QElapsedTimer since;
+    quint64 saves = 0;
+    {
+        QMutexLocker lock(&pendingMutex_);
+        flushScheduled_ = false;
+        if (waiters_.empty())
+            return;
+
+        changes = std::move(pending_);
+        pending_ = std::vector<ContactChange>();
+        outbox = std::move(pendingOutbox_);
+        pendingOutbox_ = std::vector<ContactChange>();
+        waiters = std::move(waiters_);
+        waiters_ = std::vector<QFutureInterface<QString>>();
+        since = pendingSince_;
+        pendingSince_.invalidate();
+        saves = pendingSaves_;
+        pendingSaves_ = 0;
+    }
+
+    const QString error = commitChanges(changes, outbox, since, saves);
+    for (QFutureInterface<QString> &waiter : waiters)
+    {
+        waiter.reportResult(error);
+        waiter.reportFinished();
+    }
+}
+
+void FileContactRepository::flush()
+{
+    commitPool_.waitForDone();
+    flushPending();
+}
+
+void FileContactRepository::saveAll(const std::vector<Contact> &contacts)
+{
+    flush();
+
+    QElapsedTimer since;
+    since.start();
+
+    QMutexLocker lock(&stateMutex_);
+    QString error;
+    const bool ok = persist(contacts, error);
+    recordCommit(ok, since, 1);
+
+    QMutexLocker status(&statusMutex_);
+    lastError_ = ok ? QString() : (error.isEmpty() ? QString("write failed: ") + filePath_ : error);
+}
+
+QFuture<QString> FileContactRepository::applyChanges(std::vector<ContactChange> changes, bool queueForDb)
+{
+    QFutureInterface<QString> done;
+    done.reportStarted();
+    QFuture<QString> future = done.future();
+
+    if (groupCommitWindowMs_ <= 0)
+    {
+        QElapsedTimer since;
+        since.start();
+        done.reportResult(commitChanges(changes, queueForDb ? changes : std::vector<ContactChange>(), since, 1));
+        done.reportFinished();
+        return future;
+    }
+
+    {
+        QMutexLocker lock(&pendingMutex_);
+        if (queueForDb)
+            pendingOutbox_.insert(pendingOutbox_.end(), changes.begin(), changes.end());
+        pending_.insert(pending_.end(), std::make_move_iterator(changes.begin()), std::make_move_iterator(changes.end()));
+        waiters_.push_back(done);
+        ++pendingSaves_;
+        if (!pendingSince_.isValid())
+            pendingSince_.start();
+
+        if (flushScheduled_)
+            return future;
+        flushScheduled_ = true;
+    }
+
+    const unsigned long window = static_cast<unsigned long>(groupCommitWindowMs_);
+    QtConcurrent::run(&commitPool_, [this, window]
+                      {
+        QThread::msleep(window);
+        flushPending(); });
+    return future;
+}
+
+QString FileContactRepository::outboxPath() const
+{
+    return filePath_ + ".dbpending";
+}
+
+bool FileContactRepository::hasOutbox() const
+{
+    return QFileInfo::exists(outboxPath());
+}
+
+bool FileContactRepository::enqueueForDb(const std::vector<ContactChange> &changes)
+{
+    flush();
+
+    QMutexLocker lock(&stateMutex_);
+    QString error;
+    const bool ok = appendOutbox(changes, error);
+
+    QMutexLocker status(&statusMutex_);
+    lastError_ = error;
+    return ok;
+}
+
+bool FileContactRepository::appendOutbox(const std::vector<ContactChange> &changes, QString &error)
+{
+    if (changes.empty())
+        return true;
+
+    if (!outboxSeqKnown_)
+    {
+        std::vector<ContactChange> queued;
+        if (!readOutboxLocked(queued, outboxSeq_, error))
+            return false;
+        outboxSeqKnown_ = true;
+    }
+
+    QByteArray records;
+    quint64 seq = outboxSeq_;
+    for (const ContactChange &change : changes)
+        records += changeRecord(++seq, change);
+
+    if (!appendRecords(outboxPath(), records, error))
+        return false;
+
+    outboxSeq_ = seq;
+    return true;
+}
+
+std::vector<ContactChange> FileContactRepository::readOutbox(quint64 &upToSeq)
+{
+    flush();
+
+    QMutexLocker lock(&stateMutex_);
+    std::vector<ContactChange> changes;
+    QString error;
+    upToSeq = 0;
+    if (readOutboxLocked(changes, upToSeq, error))
+    {
+        outboxSeq_ = qMax(outboxSeq_, upToSeq);
+        outboxSeqKnown_ = true;
+    }
+
+    QMutexLocker status(&statusMutex_);
+    lastError_ = error;
+    return changes;
+}
+
+bool FileContactRepository::readOutboxLocked(std::vector<ContactChange> &changes, quint64 &lastSeq, QString &error)
+{
+    lastSeq = 0;
+
+    QFile file(outboxPath());
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    file.close();
+
+    QHash<qint64, std::size_t> slotOf;
+    qint64 valid = 0;
+    int records = 0;
+    const LogStatus status = readLog(data, valid, records, [&](JournalRecord &&record)
+                                     {
+        if (record.op != 'S' && record.op != 'R')
+            return false;
+
+        lastSeq = record.seq;
+        ContactChange change = (record.op == 'S') ? ContactChange::upsert(std::move(record.contact))
+                                                  : ContactChange::remove(record.key);
+        const auto it = slotOf.constFind(change.id);
+        if (it != slotOf.constEnd())
+        {
+            changes[it.value()] = std::move(change);
+            return true;
+        }
+
+        slotOf.insert(change.id, changes.size());
+        changes.push_back(std::move(change));
+        return true; });
+
+    if (status == LogStatus::Corrupt)
+    {
+        error = QString("DB outbox %1 is corrupt at byte %2").arg(outboxPath()).arg(valid);
+        changes.clear();
+        return false;
+    }
+
+    if (status == LogStatus::TornTail)
+    {
+        qCWarning(logFile) << "DB outbox has a torn final record, truncated at byte" << valid;
+        QFile::resize(outboxPath(), valid);
+    }
+    return true;
+}
+
+bool FileContactRepository::ackOutbox(quint64 upToSeq)
+{
+    return rewriteOutbox([upToSeq](quint64 seq, qint64)
+                         { return seq <= upToSeq; },
+                         QString());
+}
+
+bool FileContactRepository::rejectOutbox(const QSet<qint64> &ids, quint64 upToSeq)
+{
+    return rewriteOutbox([&ids, upToSeq](quint64 seq, qint64 id)
+                         { return seq <= upToSeq && ids.contains(id); },
+                         rejectedOutboxPath());
+}
+
+QString FileContactRepository::rejectedOutboxPath() const
+{
+    return filePath_ + ".dbrejected";
+}
+
+bool FileContactRepository::rewriteOutbox(const std::function<bool(quint64 seq, qint64 id)> &drop, const QString &keepDroppedIn)
+{
+    QMutexLocker lock(&stateMutex_);
+
+    QString error;
+    QFile file(outboxPath());
+    if (file.open(QIODevice::ReadOnly))
+    {
+        const QByteArray data = file.readAll();
+        file.close();
+
+        QByteArray rest;
+        QByteArray dropped;
+        qint64 valid = 0;
+        int records = 0;
+        readLog(data, valid, records, [&](JournalRecord &&record)
+                {
+            const bool dropping = drop(record.seq, record.key);
+            if (dropping && keepDroppedIn.isEmpty())
+                return true;
+            QByteArray &out = dropping ? dropped : rest;
+            out += (record.op == 'R') ? journalRecord(record.seq, 'R', record.key, nullptr)
+                                      : journalRecord(record.seq, 'S', record.key, &record.contact);
+            return true; });
+
+        QFile kept(keepDroppedIn);
+        if (!keepDroppedIn.isEmpty() && !dropped.isEmpty() &&
+            (!kept.open(QIODevice::WriteOnly | QIODevice::Append) || kept.write(dropped) != dropped.size() || !kept.flush()))
+            error = kept.errorString();
+        else if (rest.isEmpty())
+        {
+            if (!QFile::remove(outboxPath()))
+                error = "cannot remove " + outboxPath();
+        }
+        else
+        {
+            QSaveFile out(outboxPath());
+            if (!out.open(QIODevice::WriteOnly) || out.write(rest) != rest.size() || !out.commit())
+                error = out.errorString();
+        }
+    }
+
+    QMutexLocker status(&statusMutex_);
+    lastError_ = error;
+    return error.isEmpty();
 }
@@ -0,0 +1,75 @@
+#include "live_rows.hpp"
+
+namespace
+{
+    int lowBit(int i)
+    {
+        return i & -i;
+    }
+}
+
+void LiveRows::clear()
+{
+    tree_.clear();
+    live_ = 0;
+}
+
+void LiveRows::assign(int count)
+{
+    tree_.resize(static_cast<std::size_t>(count));
+    for (int i = 1; i <= count; ++i)
+        tree_[static_cast<std::size_t>(i - 1)] = lowBit(i);
+    live_ = count;
+}
+
+void LiveRows::append()
+{
+    const int i = static_cast<int>(tree_.size()) + 1;
+    tree_.push_back(1 + prefix(i - 1) - prefix(i - lowBit(i)));
+    ++live_;
+}
+
+void LiveRows::remove(int pos)
+{
+    for (int i = pos + 1; i <= static_cast<int>(tree_.size()); i += lowBit(i))
+        --tree_[static_cast<std::size_t>(i - 1)];
+    --live_;
+}
+
+int LiveRows::size() const
+{
+    return live_;
+}
+
+int LiveRows::rank(int pos) const
+{
+    return prefix(pos);
+}
+
+int LiveRows::select(int rank) const
+{
+    const int n = static_cast<int>(tree_.size());
+    int step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+
+    int pos = 0;
+    for (; step > 0; step /= 2)
+    {
+        const int next = pos + step;
+        if (next <= n && tree_[static_cast<std::size_t>(next - 1)] <= rank)
+        {
+            pos = next;
+            rank -= tree_[static_cast<std::size_t>(next - 1)];
+        }
+    }
+    return pos;
+}
+
+int LiveRows::prefix(int count) const
+{
+    int sum = 0;
+    for (int i = count; i > 0; i -= lowBit(i))
+        sum += tree_[static_cast<std::size_t>(i - 1)];
+    return sum;
+}
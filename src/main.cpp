@@ -2,13 +2,17 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QFileInfo>
+#include <QLoggingCategory>
 #include <QtSql/QSqlDatabase>
 
 #include "db_config.hpp"
 #include "db_contact_repository.hpp"
-#include "dual_contact_repository.hpp"
+#include "db_health_monitor.hpp"
 #include "file_contact_repository.hpp"
 #include "main_window.hpp"
+#include "repository_worker.hpp"
+
+Q_DECLARE_LOGGING_CATEGORY(logFile)
 
 static QString findProjectRoot()
 {
@@ -30,26 +34,47 @@ int main(int argc, char **argv)
     const QString root = findProjectRoot();
     QDir::setCurrent(root);
 
-    FileContactRepository fileRepo(QDir(root).filePath("contacts.txt"));
+    const QString snapshotPath = QDir(root).filePath("contacts.pbk");
+    const QString textPath = QDir(root).filePath("contacts.txt");
+
+    FileContactRepository fileRepo(snapshotPath, FileContactRepository::Format::Binary);
+    fileRepo.setJournaled(true);
+    fileRepo.setGroupCommitWindow(100);
+
+    if (!QFileInfo::exists(snapshotPath) && QFileInfo::exists(textPath))
+    {
+        FileContactRepository legacy(textPath);
+        const std::vector<Contact> imported = legacy.loadAll();
+        if (!legacy.lastError().isEmpty())
+            qCWarning(logFile) << "contacts.txt import skipped, will retry on next start:" << legacy.lastError();
+        else
+            fileRepo.saveAll(imported);
+    }
 
     DbConfig cfg;
     const bool cfgOk = cfg.isValid();
 
     DbContactRepository dbRepo(cfg.host, cfg.port, cfg.name, cfg.user, cfg.password);
-    const bool dbOk = cfgOk && dbRepo.initialize();
+    dbRepo.circuitBreaker().configure(3, 10 * 1000);
 
-    DualContactRepository dualRepo(dbRepo, fileRepo);
-    ContactRepository *repo = dbOk ? static_cast<ContactRepository *>(&dualRepo)
-                                   : static_cast<ContactRepository *>(&fileRepo);
+    RepositoryWorker worker(dbRepo, fileRepo);
+    worker.start();
+    if (cfgOk)
+        worker.connectDb();
 
-    MainWindow w(*repo);
+    MainWindow w(worker);
+    if (!cfgOk)
+        w.setDbStatus(false, "DB: offline (invalid config)");
 
-    if (dbOk)
-        w.setDbStatus(true, "DB: online");
-    else
-        w.setDbStatus(false, cfgOk ? ("DB: offline " + dbRepo.lastError())
-                                   : "DB: offline (invalid config)");
+    DbHealthMonitor monitor(cfg);
+    QObject::connect(&monitor, &DbHealthMonitor::healthChanged, &worker, &RepositoryWorker::setDbHealth);
+    if (cfgOk)
+        monitor.start();
 
     w.show();
-    return app.exec();
+    const int rc = app.exec();
+
+    monitor.stop();
+    worker.shutdown();
+    return rc;
 }
@@ -3,41 +3,83 @@
 #include <QAction>
 #include <QAbstractItemView>
 #include <QCloseEvent>
+#include <QFileDialog>
 #include <QHeaderView>
 #include <QLineEdit>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
-#include <QRegularExpression>
 #include <QStatusBar>
 #include <QTableView>
 #include <QToolBar>
 #include <QVBoxLayout>
 #include <QWidget>
 
+#include <memory>
+#include <utility>
+
 #include "contact_dialog.hpp"
+#include "contact_search_pipeline.hpp"
 #include "contact_table_model.hpp"
 #include "multi_field_proxy_model.hpp"
+#include "repository_worker.hpp"
+
+namespace
+{
+    constexpr int kPageSize = 200;
+    constexpr int kResidentPages = 10;
+}
 
-MainWindow::MainWindow(ContactRepository &repo)
-    : repo_(repo)
+MainWindow::MainWindow(RepositoryWorker &worker)
+    : worker_(worker)
 {
     buildUi();
     buildMenu();
     buildToolbar();
+
+    connect(&worker_, &RepositoryWorker::loadBatch, this, &MainWindow::onLoadBatch);
+    connect(&worker_, &RepositoryWorker::loadFinished, this, &MainWindow::onLoadFinished);
+    connect(&worker_, &RepositoryWorker::saveFinished, this, &MainWindow::onSaveFinished);
+    connect(&worker_, &RepositoryWorker::importFinished, this, &MainWindow::onImportFinished);
+    connect(&worker_, &RepositoryWorker::pendingSynced, this, &MainWindow::reloadPagedView);
+    connect(&worker_, &RepositoryWorker::pageFetched, this, &MainWindow::onPageFetched);
+    connect(&worker_, &RepositoryWorker::remoteChanges, this, &MainWindow::onRemoteChanges);
+    connect(&worker_, &RepositoryWorker::dbStatusChanged, this, &MainWindow::setDbStatus);
+    connect(&worker_, &RepositoryWorker::breakerChanged, this, [this](const QString &state, quint64 trips)
+            {
+        breakerMsg_ = QString("breaker: %1, срабатываний: %2").arg(state).arg(trips);
+        updateStatusLine(state == "closed" ? QString() : "DB недоступна, запросы отклоняются"); });
+
+    dbOnline_ = worker_.dbOnline();
+    dbMsg_ = worker_.dbStatusMessage().trimmed();
+
+    if (dbOnline_ || worker_.dbConnecting())
+        setPagedMode(true);
+
     loadFromStorage();
 }
 
+MainWindow::~MainWindow() = default;
+
 void MainWindow::setDbStatus(bool online, const QString &message)
 {
+    const bool promoted = online && !dbOnline_ && !loading_;
+
     dbOnline_ = online;
     dbMsg_ = message.trimmed();
+
+    if (online || !worker_.dbConnecting())
+        setPagedMode(online);
+
     updateStatusLine(dbMsg_);
+
+    if (promoted)
+        loadFromStorage();
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    saveToStorage();
+    worker_.flush();
     QMainWindow::closeEvent(event);
 }
 
@@ -47,9 +89,12 @@ void MainWindow::buildUi()
     proxy_ = new MultiFieldProxyModel(this);
 
     proxy_->setSourceModel(model_);
-    proxy_->setFilterKeyColumn(-1);
-    proxy_->setFilterCaseSensitivity(Qt::CaseInsensitive);
-    proxy_->setDynamicSortFilter(true);
+
+    searchPipeline_ = std::make_unique<ContactSearchPipeline>(model_->searchIndex(), [this]
+                                                              { return model_->rowIds(); });
+    connect(searchPipeline_.get(), &ContactSearchPipeline::resultsReady, this,
+            [this](std::shared_ptr<const std::vector<int>> rows, std::shared_ptr<const std::vector<qint64>> rowIds)
+            { applySearchResults(std::move(rows), rowIds); });
 
     table_ = new QTableView(this);
     table_->setModel(proxy_);
@@ -64,6 +109,12 @@ void MainWindow::buildUi()
     connect(search_, &QLineEdit::textChanged, this, [this](const QString &t)
             { applySearch(t); });
 
+    connect(model_, &ContactTableModel::pageRequested, this,
+            [this](quint64 token, int page, const ContactQuery &query, const ContactCursor &after, int limit)
+            { worker_.fetchPage(token, page, query, after, limit); });
+    connect(model_, &ContactTableModel::pagesReset, this, [this]
+            { worker_.cancelPageFetches(); });
+
     auto *root = new QWidget(this);
     auto *layout = new QVBoxLayout(root);
     layout->setContentsMargins(10, 10, 10, 10);
@@ -86,7 +137,18 @@ void MainWindow::buildMenu()
     connect(load, &QAction::triggered, this, [this]
             { loadFromStorage(); });
     connect(save, &QAction::triggered, this, [this]
-            { saveToStorage(); });
+            {
+        worker_.flush();
+        updateStatusLine("Сохранено"); });
+
+    storage->addSeparator();
+    importAction_ = storage->addAction("Импорт из текста...");
+    QAction *exportAction = storage->addAction("Экспорт в текст...");
+
+    connect(importAction_, &QAction::triggered, this, [this]
+            { importText(); });
+    connect(exportAction, &QAction::triggered, this, [this]
+            { exportText(); });
 
     QMenu *app = menuBar()->addMenu("Приложение");
     QAction *exitAction = app->addAction("Выход");
@@ -114,15 +176,48 @@ void MainWindow::buildToolbar()
             { editContact(); });
 }
 
-void MainWindow::refreshModel()
+void MainWindow::setPagedMode(bool enabled)
+{
+    if (model_->isPaged() == enabled)
+        return;
+
+    const QHeaderView *header = table_->horizontalHeader();
+
+    if (enabled)
+    {
+        searchPipeline_->cancel();
+        proxy_->setAcceptedRows(nullptr);
+
+        ContactQuery query;
+        query.term = search_->text().trimmed();
+        query.sortColumn = header->sortIndicatorSection();
+        query.order = header->sortIndicatorOrder();
+        model_->setPaged(query, kPageSize, kResidentPages);
+    }
+    else
+    {
+        model_->setInMemory();
+        applySearch(search_->text());
+    }
+
+    proxy_->sort(header->sortIndicatorSection(), header->sortIndicatorOrder());
+
+    if (!enabled)
+        loadFromStorage();
+}
+
+void MainWindow::reloadPagedView()
 {
-    model_->setContacts(contacts_);
+    if (model_->isPaged())
+        model_->reload();
 }
 
 void MainWindow::updateStatusLine(const QString &extra)
 {
     const QString db = dbOnline_ ? "DB: online" : "DB: offline";
-    const QString base = QString("Контактов: %1 | %2").arg(contacts_.size()).arg(db);
+    QString base = QString("Контактов: %1 | %2").arg(model_->contactCount()).arg(db);
+    if (!breakerMsg_.isEmpty())
+        base += " | " + breakerMsg_;
 
     if (extra.trimmed().isEmpty())
     {
@@ -133,25 +228,22 @@ void MainWindow::updateStatusLine(const QString &extra)
     statusBar()->showMessage(base + " | " + extra.trimmed());
 }
 
-int MainWindow::selectedSourceRow() const
+Contact MainWindow::selectedContact() const
 {
     if (!table_->selectionModel())
-        return -1;
+        return Contact();
 
     const QModelIndexList selected = table_->selectionModel()->selectedRows();
     if (selected.isEmpty())
-        return -1;
+        return Contact();
 
     const QModelIndex viewIndex = selected.front();
     const QModelIndex srcIndex = proxy_->mapToSource(viewIndex);
     if (!srcIndex.isValid())
-        return -1;
+        return Contact();
 
-    const int row = srcIndex.row();
-    if (row < 0 || static_cast<std::size_t>(row) >= contacts_.size())
-        return -1;
-
-    return row;
+    const ContactView shown = model_->contactAt(srcIndex.row());
+    return shown.isValid() ? shown.toContact() : Contact();
 }
 
 void MainWindow::addContact()
@@ -160,93 +252,234 @@ void MainWindow::addContact()
     if (dlg.exec() != QDialog::Accepted)
         return;
 
-    contacts_.push_back(dlg.contact());
-
-    refreshModel();
-    saveToStorage();
+    const Contact contact = dlg.contact();
+    model_->insertContact(contact);
 
-    if (repo_.lastError().trimmed().isEmpty())
-        updateStatusLine("Добавлен контакт");
+    refreshSearch();
+    saveToStorage({ContactChange::upsert(contact)}, "Добавлен контакт");
 }
 
 void MainWindow::editContact()
 {
-    const int row = selectedSourceRow();
-    if (row < 0)
+    const Contact selected = selectedContact();
+    if (selected.id() == 0)
         return;
 
     ContactDialog dlg(this);
-    dlg.setContact(contacts_[static_cast<std::size_t>(row)]);
+    dlg.setContact(selected);
 
     if (dlg.exec() != QDialog::Accepted)
         return;
 
-    contacts_[static_cast<std::size_t>(row)] = dlg.contact();
-
-    refreshModel();
-    saveToStorage();
+    const Contact contact = dlg.contact();
+    model_->updateContact(contact);
 
-    if (repo_.lastError().trimmed().isEmpty())
-        updateStatusLine("Контакт изменён");
+    refreshSearch();
+    saveToStorage({ContactChange::upsert(contact)}, "Контакт изменён");
 }
 
 void MainWindow::removeContact()
 {
-    const int row = selectedSourceRow();
-    if (row < 0)
+    const qint64 id = selectedContact().id();
+    if (id == 0)
         return;
 
     const auto r = QMessageBox::question(this, "Удаление", "Удалить выбранный контакт?");
     if (r != QMessageBox::Yes)
         return;
 
-    contacts_.erase(contacts_.begin() + row);
+    model_->removeContact(id);
 
-    refreshModel();
-    saveToStorage();
+    refreshSearch();
+    saveToStorage({ContactChange::remove(id)}, "Контакт удалён");
+}
 
-    if (repo_.lastError().trimmed().isEmpty())
-        updateStatusLine("Контакт удалён");
+void MainWindow::setEditingEnabled(bool enabled)
+{
+    addAction_->setEnabled(enabled);
+    editAction_->setEnabled(enabled);
+    removeAction_->setEnabled(enabled);
+    importAction_->setEnabled(enabled);
 }
 
 void MainWindow::loadFromStorage()
 {
-    contacts_ = repo_.loadAll();
-    refreshModel();
+    if (model_->isPaged())
+    {
+        loading_ = false;
+        setEditingEnabled(true);
+        model_->reload();
+        updateStatusLine("Загрузка страниц...");
+        return;
+    }
+
+    loading_ = true;
+    setEditingEnabled(false);
+    worker_.loadAll();
+    updateStatusLine("Загрузка...");
+}
+
+void MainWindow::saveToStorage(std::vector<ContactChange> changes, const QString &doneMessage)
+{
+    if (loading_ || changes.empty())
+        return;
+
+    saveMessage_ = doneMessage;
+    worker_.saveChanges(std::move(changes));
+}
+
+void MainWindow::onLoadBatch(const std::vector<Contact> &batch, bool first)
+{
+    if (!loading_ || model_->isPaged())
+        return;
+
+    if (first)
+        model_->setContacts(batch);
+    else
+        model_->insertContacts(batch);
+
+    updateStatusLine(QString("Загрузка... (%1)").arg(model_->contactCount()));
+}
+
+void MainWindow::onLoadFinished(const QString &error)
+{
+    if (!loading_)
+        return;
+
+    loading_ = false;
+    setEditingEnabled(true);
+    refreshSearch();
 
-    const QString err = repo_.lastError().trimmed();
-    if (!err.isEmpty())
+    if (!error.isEmpty())
     {
-        updateStatusLine("Ошибка: " + err);
+        updateStatusLine("Ошибка: " + error);
         return;
     }
 
-    updateStatusLine(QString("Загружено (%1)").arg(contacts_.size()));
+    updateStatusLine(QString("Загружено (%1)").arg(model_->contactCount()));
 }
 
-void MainWindow::saveToStorage()
+void MainWindow::onSaveFinished(const QString &error)
 {
-    repo_.saveAll(contacts_);
+    if (!error.isEmpty())
+    {
+        updateStatusLine("Ошибка: " + error);
+        return;
+    }
+
+    updateStatusLine(saveMessage_);
+}
+
+void MainWindow::onRemoteChanges(const std::vector<Contact> &changed, const std::vector<qint64> &removed)
+{
+    if (loading_)
+        return;
+
+    for (const Contact &c : changed)
+        model_->updateContact(c);
 
-    const QString err = repo_.lastError().trimmed();
-    if (!err.isEmpty())
+    for (const qint64 id : removed)
+        model_->removeContact(id);
+
+    refreshSearch();
+    updateStatusLine(QString("Обновлено с сервера (%1)").arg(changed.size() + removed.size()));
+    reloadPagedView();
+}
+
+void MainWindow::importText()
+{
+    const QString path = QFileDialog::getOpenFileName(this, "Импорт", QString(), "Текст (*.txt);;Все файлы (*)");
+    if (path.isEmpty())
+        return;
+
+    if (loading_)
+        return;
+
+    worker_.importFrom(path);
+    updateStatusLine("Импорт...");
+}
+
+void MainWindow::onImportFinished(const std::vector<Contact> &imported, const QString &error)
+{
+    if (!error.isEmpty())
     {
-        updateStatusLine("Ошибка: " + err);
+        updateStatusLine("Ошибка: " + error);
         return;
     }
 
-    updateStatusLine(QString("Сохранено (%1)").arg(contacts_.size()));
+    saveMessage_ = QString("Импортировано (%1)").arg(imported.size());
+    if (loading_)
+        return;
+
+    model_->insertContacts(imported);
+    refreshSearch();
+    updateStatusLine(saveMessage_);
+}
+
+void MainWindow::exportText()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Экспорт", "contacts.txt", "Текст (*.txt)");
+    if (path.isEmpty())
+        return;
+
+    saveMessage_ = "Экспортировано";
+    worker_.exportTo(path);
 }
 
 void MainWindow::applySearch(const QString &text)
 {
     const QString t = text.trimmed();
-    if (t.isEmpty())
+
+    if (model_->isPaged())
+    {
+        model_->setSearchTerm(t);
+        return;
+    }
+
+    searchPipeline_->setQuery(t);
+}
+
+void MainWindow::applySearchResults(std::shared_ptr<const std::vector<int>> rows,
+                                    const std::shared_ptr<const std::vector<qint64>> &rowIds)
+{
+    if (model_->isPaged())
+        return;
+
+    if (rows && !model_->rowIdsCurrent(rowIds))
+    {
+        searchPipeline_->refresh();
+        return;
+    }
+
+    const qint64 selected = selectedContact().id();
+    proxy_->setAcceptedRows(std::move(rows));
+
+    const int row = selected == 0 ? -1 : model_->rowOfId(selected);
+    if (row < 0)
+        return;
+
+    const QModelIndex shown = proxy_->mapFromSource(model_->index(row, 0));
+    if (shown.isValid())
+        table_->selectRow(shown.row());
+}
+
+void MainWindow::refreshSearch()
+{
+    if (!model_->isPaged())
+        searchPipeline_->refresh();
+}
+
+void MainWindow::onPageFetched(quint64 token, int page, const ContactPage &result, const QString &error)
+{
+    if (!model_->isPaged())
+        return;
+
+    if (!error.isEmpty())
     {
-        proxy_->setFilterRegularExpression(QRegularExpression());
+        model_->pageFailed(token, page);
+        updateStatusLine("Ошибка: " + error);
         return;
     }
 
-    const QString escaped = QRegularExpression::escape(t);
-    proxy_->setFilterRegularExpression(QRegularExpression(escaped, QRegularExpression::CaseInsensitiveOption));
+    model_->applyPage(token, page, result);
 }
@@ -2,31 +2,304 @@
 
 #include <QAbstractItemModel>
 
+#include <algorithm>
+#include <utility>
+
 MultiFieldProxyModel::MultiFieldProxyModel(QObject *parent)
-    : QSortFilterProxyModel(parent)
+    : QAbstractProxyModel(parent)
+{
+}
+
+void MultiFieldProxyModel::setSourceModel(QAbstractItemModel *source)
+{
+    beginResetModel();
+
+    for (const QMetaObject::Connection &c : connections_)
+        disconnect(c);
+    connections_.clear();
+
+    QAbstractProxyModel::setSourceModel(source);
+    rows_.reset();
+
+    if (source)
+    {
+        connections_ << connect(source, &QAbstractItemModel::modelAboutToBeReset, this, [this]
+                                { beginResetModel(); });
+        connections_ << connect(source, &QAbstractItemModel::modelReset, this, [this]
+                                {
+            if (rows_)
+                rows_ = std::make_shared<const std::vector<int>>();
+            endResetModel(); });
+        connections_ << connect(source, &QAbstractItemModel::rowsAboutToBeInserted, this,
+                                [this](const QModelIndex &, int first, int last)
+                                {
+            if (!rows_)
+                beginInsertRows(QModelIndex(), first, last); });
+        connections_ << connect(source, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last)
+                                { onRowsInserted(first, last); });
+        connections_ << connect(source, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+                                [this](const QModelIndex &, int first, int last)
+                                { onRowsAboutToBeRemoved(first, last); });
+        connections_ << connect(source, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last)
+                                { onRowsRemoved(first, last); });
+        connections_ << connect(source, &QAbstractItemModel::rowsAboutToBeMoved, this,
+                                [this](const QModelIndex &, int first, int last, const QModelIndex &, int destination)
+                                { onRowsAboutToBeMoved(first, last, destination); });
+        connections_ << connect(source, &QAbstractItemModel::rowsMoved, this,
+                                [this](const QModelIndex &, int first, int last, const QModelIndex &, int destination)
+                                { onRowsMoved(first, last, destination); });
+        connections_ << connect(source, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]
+                                { onLayoutAboutToBeChanged(); });
+        connections_ << connect(source, &QAbstractItemModel::layoutChanged, this, [this]
+                                { onLayoutChanged(); });
+        connections_ << connect(source, &QAbstractItemModel::dataChanged, this, &MultiFieldProxyModel::onDataChanged);
+        connections_ << connect(source, &QAbstractItemModel::headerDataChanged, this, &QAbstractItemModel::headerDataChanged);
+    }
+
+    endResetModel();
+}
+
+void MultiFieldProxyModel::setAcceptedRows(std::shared_ptr<const std::vector<int>> rows)
+{
+    if (!rows && !rows_)
+        return;
+
+    beginResetModel();
+    rows_ = std::move(rows);
+    endResetModel();
+}
+
+bool MultiFieldProxyModel::isFiltered() const
+{
+    return rows_ != nullptr;
+}
+
+QModelIndex MultiFieldProxyModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || column < 0 || row >= rowCount() || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex MultiFieldProxyModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+QModelIndex MultiFieldProxyModel::sibling(int row, int column, const QModelIndex &idx) const
+{
+    return index(row, column, idx.parent());
+}
+
+int MultiFieldProxyModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !sourceModel())
+        return 0;
+    return rows_ ? static_cast<int>(rows_->size()) : sourceModel()->rowCount();
+}
+
+int MultiFieldProxyModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !sourceModel())
+        return 0;
+    return sourceModel()->columnCount();
+}
+
+QModelIndex MultiFieldProxyModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel())
+        return QModelIndex();
+
+    const int row = rows_ ? (*rows_)[static_cast<std::size_t>(proxyIndex.row())] : proxyIndex.row();
+    return sourceModel()->index(row, proxyIndex.column());
+}
+
+QModelIndex MultiFieldProxyModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+        return QModelIndex();
+
+    if (!rows_)
+        return index(sourceIndex.row(), sourceIndex.column());
+
+    const int row = proxyLowerBound(sourceIndex.row());
+    if (row >= static_cast<int>(rows_->size()) || (*rows_)[static_cast<std::size_t>(row)] != sourceIndex.row())
+        return QModelIndex();
+    return index(row, sourceIndex.column());
+}
+
+void MultiFieldProxyModel::sort(int column, Qt::SortOrder order)
+{
+    if (sourceModel())
+        sourceModel()->sort(column, order);
+}
+
+int MultiFieldProxyModel::proxyLowerBound(int sourceRow) const
+{
+    return static_cast<int>(std::lower_bound(rows_->begin(), rows_->end(), sourceRow) - rows_->begin());
+}
+
+void MultiFieldProxyModel::onRowsInserted(int first, int last)
 {
-    setFilterCaseSensitivity(Qt::CaseInsensitive);
-    setSortCaseSensitivity(Qt::CaseInsensitive);
+    if (!rows_)
+    {
+        endInsertRows();
+        return;
+    }
+
+    const int count = last - first + 1;
+    auto rows = std::make_shared<std::vector<int>>(*rows_);
+    for (int &row : *rows)
+    {
+        if (row >= first)
+            row += count;
+    }
+    rows_ = std::move(rows);
+}
+
+void MultiFieldProxyModel::onRowsAboutToBeRemoved(int first, int last)
+{
+    if (!rows_)
+    {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+
+    removeFirst_ = proxyLowerBound(first);
+    removeLast_ = proxyLowerBound(last + 1) - 1;
+    if (removeFirst_ <= removeLast_)
+        beginRemoveRows(QModelIndex(), removeFirst_, removeLast_);
+}
+
+void MultiFieldProxyModel::onRowsRemoved(int first, int last)
+{
+    if (!rows_)
+    {
+        endRemoveRows();
+        return;
+    }
+
+    const int count = last - first + 1;
+    auto rows = std::make_shared<std::vector<int>>();
+    rows->reserve(rows_->size());
+    for (const int row : *rows_)
+    {
+        if (row < first)
+            rows->push_back(row);
+        else if (row > last)
+            rows->push_back(row - count);
+    }
+    rows_ = std::move(rows);
+
+    if (removeFirst_ <= removeLast_)
+        endRemoveRows();
+    removeFirst_ = -1;
+    removeLast_ = -1;
+}
+
+void MultiFieldProxyModel::onRowsAboutToBeMoved(int first, int last, int destination)
+{
+    if (!rows_)
+    {
+        beginMoveRows(QModelIndex(), first, last, QModelIndex(), destination);
+        return;
+    }
+
+    emit layoutAboutToBeChanged();
+    savePersistent();
 }
 
-bool MultiFieldProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+void MultiFieldProxyModel::onRowsMoved(int first, int last, int destination)
 {
-    const auto rx = filterRegularExpression();
-    if (rx.pattern().isEmpty())
-        return true;
+    if (!rows_)
+    {
+        endMoveRows();
+        return;
+    }
 
-    const auto *m = sourceModel();
-    if (!m)
-        return true;
+    const int count = last - first + 1;
+    auto rows = std::make_shared<std::vector<int>>(*rows_);
+    for (int &row : *rows)
+    {
+        if (row >= first && row <= last)
+            row += destination > last ? destination - last - 1 : destination - first;
+        else if (destination > last && row > last && row < destination)
+            row -= count;
+        else if (destination < first && row >= destination && row < first)
+            row += count;
+    }
+    std::sort(rows->begin(), rows->end());
+    rows_ = std::move(rows);
+
+    restorePersistent();
+    emit layoutChanged();
+}
+
+void MultiFieldProxyModel::savePersistent()
+{
+    layoutProxy_ = persistentIndexList();
+    layoutSource_.clear();
+    layoutSource_.reserve(layoutProxy_.size());
+    for (const QModelIndex &idx : layoutProxy_)
+        layoutSource_.append(QPersistentModelIndex(mapToSource(idx)));
+}
+
+void MultiFieldProxyModel::restorePersistent()
+{
+    QModelIndexList to;
+    to.reserve(layoutProxy_.size());
+    for (const QPersistentModelIndex &idx : layoutSource_)
+        to.append(mapFromSource(idx));
+    changePersistentIndexList(layoutProxy_, to);
+    layoutProxy_.clear();
+    layoutSource_.clear();
+}
 
-    const int cols = m->columnCount(sourceParent);
-    for (int col = 0; col < cols; ++col)
+void MultiFieldProxyModel::onLayoutAboutToBeChanged()
+{
+    emit layoutAboutToBeChanged();
+    savePersistent();
+
+    layoutAccepted_.clear();
+    if (!rows_)
+        return;
+
+    layoutAccepted_.reserve(static_cast<int>(rows_->size()));
+    for (const int row : *rows_)
+        layoutAccepted_.append(QPersistentModelIndex(sourceModel()->index(row, 0)));
+}
+
+void MultiFieldProxyModel::onLayoutChanged()
+{
+    if (rows_)
+    {
+        auto rows = std::make_shared<std::vector<int>>();
+        rows->reserve(static_cast<std::size_t>(layoutAccepted_.size()));
+        for (const QPersistentModelIndex &idx : layoutAccepted_)
+        {
+            if (idx.isValid())
+                rows->push_back(idx.row());
+        }
+        std::sort(rows->begin(), rows->end());
+        rows_ = std::move(rows);
+    }
+    layoutAccepted_.clear();
+
+    restorePersistent();
+    emit layoutChanged();
+}
+
+void MultiFieldProxyModel::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    if (!rows_)
     {
-        const QModelIndex idx = m->index(sourceRow, col, sourceParent);
-        const QString value = idx.data().toString();
-        if (value.contains(rx))
-            return true;
+        emit dataChanged(mapFromSource(topLeft), mapFromSource(bottomRight), roles);
+        return;
     }
 
-    return false;
+    const int first = proxyLowerBound(topLeft.row());
+    const int last = proxyLowerBound(bottomRight.row() + 1) - 1;
+    if (first <= last)
+        emit dataChanged(index(first, topLeft.column()), index(last, bottomRight.column()), roles);
 }
@@ -0,0 +1,138 @@
+#include "phone_index.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    constexpr int kMinQueryDigits = 3;
+    constexpr qint64 kMinId = std::numeric_limits<qint64>::min();
+}
+
+void PhoneIndex::clear()
+{
+    byPrefix_.clear();
+    bySuffix_.clear();
+    keysOf_.clear();
+}
+
+void PhoneIndex::rebuild(const std::vector<Contact> &contacts)
+{
+    clear();
+
+    for (const Contact &c : contacts)
+    {
+        std::vector<QByteArray> keys;
+        for (const PhoneNumber &p : c.phoneNumbers())
+        {
+            if (p.digits().isEmpty())
+                continue;
+
+            keys.push_back(p.digits());
+            byPrefix_.push_back(Entry{p.digits(), c.id()});
+            bySuffix_.push_back(Entry{reversed(p.digits()), c.id()});
+        }
+        if (!keys.empty())
+            keysOf_.insert(c.id(), std::move(keys));
+    }
+
+    std::sort(byPrefix_.begin(), byPrefix_.end());
+    std::sort(bySuffix_.begin(), bySuffix_.end());
+}
+
+void PhoneIndex::insert(qint64 id, const std::vector<PhoneNumber> &phones)
+{
+    remove(id);
+
+    std::vector<QByteArray> keys;
+    for (const PhoneNumber &p : phones)
+    {
+        if (p.digits().isEmpty())
+            continue;
+
+        keys.push_back(p.digits());
+        insertEntry(byPrefix_, Entry{p.digits(), id});
+        insertEntry(bySuffix_, Entry{reversed(p.digits()), id});
+    }
+
+    if (!keys.empty())
+        keysOf_.insert(id, std::move(keys));
+}
+
+void PhoneIndex::remove(qint64 id)
+{
+    const auto it = keysOf_.find(id);
+    if (it == keysOf_.end())
+        return;
+
+    for (const QByteArray &key : it.value())
+    {
+        removeEntry(byPrefix_, Entry{key, id});
+        removeEntry(bySuffix_, Entry{reversed(key), id});
+    }
+    keysOf_.erase(it);
+}
+
+std::vector<qint64> PhoneIndex::match(const QString &query) const
+{
+    std::vector<qint64> out;
+    if (!isPhoneQuery(query))
+        return out;
+
+    const QByteArray digits = PhoneNumber::canonicalDigits(query);
+
+    std::vector<QByteArray> prefixes{digits};
+    if (digits.startsWith('8'))
+        prefixes.push_back('7' + digits.mid(1));
+    else if (!digits.startsWith('7'))
+        prefixes.push_back('7' + digits);
+
+    for (const QByteArray &prefix : prefixes)
+        collectPrefix(byPrefix_, prefix, out);
+    collectPrefix(bySuffix_, reversed(digits), out);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+bool PhoneIndex::isPhoneQuery(const QString &query)
+{
+    int digits = 0;
+    for (const QChar ch : query)
+    {
+        if (PhoneNumber::isDigit(ch))
+            ++digits;
+        else if (ch != QLatin1Char('+') && ch != QLatin1Char('(') && ch != QLatin1Char(')') &&
+                 ch != QLatin1Char('-') && ch != QLatin1Char(' '))
+            return false;
+    }
+    return digits >= kMinQueryDigits;
+}
+
+void PhoneIndex::insertEntry(std::vector<Entry> &entries, Entry entry)
+{
+    const auto pos = std::lower_bound(entries.begin(), entries.end(), entry);
+    entries.insert(pos, std::move(entry));
+}
+
+void PhoneIndex::removeEntry(std::vector<Entry> &entries, const Entry &entry)
+{
+    const auto pos = std::lower_bound(entries.begin(), entries.end(), entry);
+    if (pos != entries.end() && pos->key == entry.key && pos->id == entry.id)
+        entries.erase(pos);
+}
+
+void PhoneIndex::collectPrefix(const std::vector<Entry> &entries, const QByteArray &prefix, std::vector<qint64> &out)
+{
+    const Entry probe{prefix, kMinId};
+    for (auto it = std::lower_bound(entries.begin(), entries.end(), probe); it != entries.end() && it->key.startsWith(prefix); ++it)
+        out.push_back(it->id);
+}
+
+QByteArray PhoneIndex::reversed(const QByteArray &key)
+{
+    QByteArray out(key);
+    std::reverse(out.begin(), out.end());
+    return out;
+}
@@ -1,7 +1,7 @@
 #include "phone_number.hpp"
 
 PhoneNumber::PhoneNumber(PhoneType type, QString value)
-    : type_(type), value_(std::move(value))
+    : type_(type), value_(std::move(value)), digits_(canonicalDigits(value_))
 {
 }
 
@@ -15,6 +15,11 @@ const QString &PhoneNumber::value() const
     return value_;
 }
 
+const QByteArray &PhoneNumber::digits() const
+{
+    return digits_;
+}
+
 void PhoneNumber::setType(PhoneType type)
 {
     type_ = type;
@@ -23,6 +28,7 @@ void PhoneNumber::setType(PhoneType type)
 void PhoneNumber::setValue(QString value)
 {
     value_ = std::move(value);
+    digits_ = canonicalDigits(value_);
 }
 
 QString PhoneNumber::typeToString(PhoneType type)
@@ -70,3 +76,26 @@ PhoneType PhoneNumber::labelToType(const QString &label)
         return PhoneType::Service;
     return PhoneType::Home;
 }
+
+QByteArray PhoneNumber::canonicalDigits(const QString &value)
+{
+    QByteArray digits;
+    digits.reserve(value.size());
+    for (const QChar ch : value)
+    {
+        if (isDigit(ch))
+            digits.append(static_cast<char>(ch.unicode()));
+    }
+
+    if (digits.size() == 11 && (digits.startsWith('8') || digits.startsWith('7')))
+        digits[0] = '7';
+    else if (digits.size() == 10)
+        digits.prepend('7');
+
+    return digits;
+}
+
+bool PhoneNumber::isDigit(QChar ch)
+{
+    return ch >= QLatin1Char('0') && ch <= QLatin1Char('9');
+}
@@ -0,0 +1,361 @@
+#include "repository_worker.hpp"
+
+#include <QLoggingCategory>
+#include <QMutexLocker>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include <algorithm>
+
+Q_DECLARE_LOGGING_CATEGORY(logDb)
+
+namespace
+{
+    constexpr int kChangeCoalesceMs = 50;
+    constexpr int kChangeRetryBaseMs = 500;
+    constexpr int kChangeRetryMaxMs = 60 * 1000;
+    constexpr int kSyncBatchMs = 200;
+}
+
+RepositoryWorker::RepositoryWorker(DbContactRepository &db, FileContactRepository &file, QObject *parent)
+    : QObject(parent),
+      db_(db),
+      file_(file),
+      dual_(db, file),
+      context_(new QObject),
+      syncTimer_(new QTimer(context_))
+{
+    qRegisterMetaType<std::vector<Contact>>("std::vector<Contact>");
+    qRegisterMetaType<std::vector<qint64>>("std::vector<qint64>");
+    qRegisterMetaType<ContactPage>("ContactPage");
+
+    db_.circuitBreaker().setStateListener([this](CircuitBreaker::State state)
+                                          { emit breakerChanged(CircuitBreaker::stateName(state), db_.circuitBreaker().metrics().trips); });
+
+    syncTimer_->setSingleShot(true);
+    connect(syncTimer_, &QTimer::timeout, context_, [this]
+            { syncPending(); });
+
+    thread_.setObjectName("phonebook-repository");
+    context_->moveToThread(&thread_);
+}
+
+RepositoryWorker::~RepositoryWorker()
+{
+    shutdown();
+    delete context_;
+}
+
+void RepositoryWorker::start()
+{
+    if (!thread_.isRunning())
+        thread_.start();
+}
+
+void RepositoryWorker::shutdown()
+{
+    if (!thread_.isRunning())
+        return;
+
+    QMetaObject::invokeMethod(
+        context_, [this]
+        {
+            syncTimer_->stop();
+            file_.flush();
+            thread_.quit(); },
+        Qt::QueuedConnection);
+    thread_.wait();
+}
+
+QFuture<bool> RepositoryWorker::connectDb()
+{
+    setDbStatus(false, "DB: подключение...", true);
+
+    return post<bool>([this]
+                      {
+        const bool ok = db_.initialize();
+        dual_.setDbOnline(ok);
+        if (ok)
+            db_.subscribeToChanges([this](qint64 id)
+                                   { onRemoteChange(id); });
+        setDbStatus(ok, ok ? QString("DB: online") : "DB: offline " + db_.lastError());
+        scheduleSync(0);
+        return ok; });
+}
+
+void RepositoryWorker::setDbHealth(bool online, const QString &message)
+{
+    post<bool>([this, online, message]
+               {
+        if (online == dual_.dbOnline())
+            return online;
+
+        if (!online)
+        {
+            dual_.setDbOnline(false);
+            db_.disconnect();
+            setDbStatus(false, "DB: offline " + message);
+            return false;
+        }
+
+        if (!db_.initialize())
+        {
+            qCWarning(logDb) << "DB promotion failed:" << db_.lastError();
+            return false;
+        }
+
+        dual_.setDbOnline(true);
+        db_.subscribeToChanges([this](qint64 id)
+                               { onRemoteChange(id); });
+        setDbStatus(true, "DB: online");
+        scheduleSync(0);
+        return true; });
+}
+
+QFuture<std::vector<Contact>> RepositoryWorker::loadAll()
+{
+    pendingLoad_.cancel();
+
+    pendingLoad_ = post<std::vector<Contact>>([this]
+                                              {
+        std::vector<Contact> contacts = dual_.loadStreamed([this](const std::vector<Contact> &batch, bool first)
+                                                           { emit loadBatch(batch, first); });
+        emit loadFinished(dual_.lastError().trimmed());
+        scheduleSync(0);
+        return contacts; });
+    return pendingLoad_;
+}
+
+QFuture<QString> RepositoryWorker::saveChanges(std::vector<ContactChange> changes)
+{
+    QFutureInterface<QString> iface;
+    iface.reportStarted();
+    QFuture<QString> future = iface.future();
+
+    QMetaObject::invokeMethod(
+        context_, [this, iface, changes = std::move(changes)]() mutable
+        { commitChanges(std::move(changes), iface); },
+        Qt::QueuedConnection);
+
+    return future;
+}
+
+void RepositoryWorker::commitChanges(std::vector<ContactChange> changes, QFutureInterface<QString> iface)
+{
+    const QFuture<QString> written = dual_.saveChanges(std::move(changes));
+
+    auto *watcher = new QFutureWatcher<QString>(context_);
+    connect(watcher, &QFutureWatcher<QString>::finished, context_, [this, iface, watcher]() mutable
+            {
+        QString error = watcher->result().trimmed();
+        if (!error.isEmpty())
+            error = "File save failed: " + error;
+        watcher->deleteLater();
+
+        emit saveFinished(error);
+        scheduleSync(kSyncBatchMs);
+        iface.reportResult(error);
+        iface.reportFinished(); });
+    watcher->setFuture(written);
+}
+
+void RepositoryWorker::importFrom(QString path)
+{
+    post<bool>([this, path]
+               {
+        FileContactRepository source(path);
+        std::vector<Contact> imported = source.loadAll();
+        const QString error = source.lastError().trimmed();
+        if (!error.isEmpty())
+        {
+            emit importFinished({}, "Import failed: " + error);
+            return false;
+        }
+
+        std::vector<ContactChange> changes;
+        changes.reserve(imported.size());
+        for (Contact &c : imported)
+        {
+            c.setId(Contact::generateId());
+            changes.push_back(ContactChange::upsert(c));
+        }
+        emit importFinished(imported, QString());
+
+        if (!changes.empty())
+        {
+            QFutureInterface<QString> iface;
+            iface.reportStarted();
+            commitChanges(std::move(changes), iface);
+        }
+        return true; });
+}
+
+void RepositoryWorker::flush()
+{
+    post<bool>([this]
+               {
+        file_.flush();
+        scheduleSync(0);
+        return true; });
+}
+
+void RepositoryWorker::exportTo(QString path)
+{
+    post<bool>([this, path]
+               {
+        file_.flush();
+        const std::vector<Contact> contacts = file_.loadAll();
+        QString error = file_.lastError().trimmed();
+        if (error.isEmpty())
+        {
+            FileContactRepository out(path);
+            out.saveAll(contacts);
+            error = out.lastError().trimmed();
+        }
+        if (!error.isEmpty())
+            error = "Export failed: " + error;
+        emit saveFinished(error);
+        return error.isEmpty(); });
+}
+
+QFuture<ContactPage> RepositoryWorker::fetchPage(quint64 token, int page, ContactQuery query, ContactCursor after, int limit)
+{
+    pendingPages_.erase(std::remove_if(pendingPages_.begin(), pendingPages_.end(), [](const QFuture<ContactPage> &f)
+                                       { return f.isFinished(); }),
+                        pendingPages_.end());
+
+    QFuture<ContactPage> future = post<ContactPage>([this, token, page, query = std::move(query), after = std::move(after), limit]
+                                                    {
+        ContactPage result;
+        QString error;
+        if (!dual_.dbOnline())
+            error = "постраничная загрузка недоступна: DB offline";
+        else
+        {
+            result = db_.searchPage(query, after, limit);
+            error = db_.lastError().trimmed();
+        }
+        emit pageFetched(token, page, result, error);
+        return result; });
+
+    pendingPages_.push_back(future);
+    return future;
+}
+
+void RepositoryWorker::cancelPageFetches()
+{
+    for (QFuture<ContactPage> &f : pendingPages_)
+        f.cancel();
+    pendingPages_.clear();
+}
+
+bool RepositoryWorker::dbOnline() const
+{
+    QMutexLocker lock(&statusMutex_);
+    return dbOnline_;
+}
+
+bool RepositoryWorker::dbConnecting() const
+{
+    QMutexLocker lock(&statusMutex_);
+    return dbConnecting_;
+}
+
+QString RepositoryWorker::dbStatusMessage() const
+{
+    QMutexLocker lock(&statusMutex_);
+    return dbMessage_;
+}
+
+void RepositoryWorker::scheduleSync(int delayMs)
+{
+    if (!dual_.hasPendingSync() || !dual_.dbOnline() || syncTimer_->isActive())
+        return;
+
+    syncTimer_->start(delayMs);
+}
+
+void RepositoryWorker::syncPending()
+{
+    if (dual_.syncPending())
+    {
+        if (dual_.syncedChanges() > 0)
+            emit pendingSynced();
+        return;
+    }
+
+    if (!dual_.dbOnline())
+        return;
+
+    syncTimer_->start(dual_.retryDelayMs());
+}
+
+void RepositoryWorker::onRemoteChange(qint64 id)
+{
+    changedIds_.insert(id);
+    scheduleChangeFetch(kChangeCoalesceMs);
+}
+
+void RepositoryWorker::scheduleChangeFetch(int delayMs)
+{
+    if (changeFetchScheduled_)
+        return;
+
+    changeFetchScheduled_ = true;
+    QTimer::singleShot(delayMs, context_, [this]
+                       { fetchRemoteChanges(); });
+}
+
+void RepositoryWorker::fetchRemoteChanges()
+{
+    changeFetchScheduled_ = false;
+
+    std::vector<qint64> ids(changedIds_.begin(), changedIds_.end());
+    changedIds_.clear();
+
+    std::vector<Contact> changed = db_.fetchByIds(ids);
+    if (!db_.lastError().isEmpty())
+    {
+        for (const qint64 id : ids)
+            changedIds_.insert(id);
+
+        ++changeFetchFailures_;
+        const int delayMs = std::min(kChangeRetryMaxMs, kChangeRetryBaseMs << std::min(changeFetchFailures_, 16));
+        qCWarning(logDb) << "fetching remote changes failed, retry in" << delayMs << "ms:" << db_.lastError();
+        scheduleChangeFetch(delayMs);
+        return;
+    }
+    changeFetchFailures_ = 0;
+
+    QSet<qint64> present;
+    for (const Contact &c : changed)
+        present.insert(c.id());
+
+    std::vector<qint64> removed;
+    for (const qint64 id : ids)
+    {
+        if (!present.contains(id))
+            removed.push_back(id);
+    }
+
+    std::vector<ContactChange> mirrored;
+    mirrored.reserve(changed.size() + removed.size());
+    for (const Contact &c : changed)
+        mirrored.push_back(ContactChange::upsert(c));
+    for (const qint64 id : removed)
+        mirrored.push_back(ContactChange::remove(id));
+    dual_.applyRemote(std::move(mirrored));
+
+    emit remoteChanges(changed, removed);
+}
+
+void RepositoryWorker::setDbStatus(bool online, const QString &message, bool connecting)
+{
+    {
+        QMutexLocker lock(&statusMutex_);
+        dbOnline_ = online;
+        dbConnecting_ = connecting;
+        dbMessage_ = message;
+    }
+    emit dbStatusChanged(online, message);
+}
@@ -0,0 +1,259 @@
+#include "schema_migrator.hpp"
+
+#include <QLoggingCategory>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include <utility>
+
+Q_DECLARE_LOGGING_CATEGORY(logDb)
+
+namespace
+{
+    constexpr qint64 kMigrationLockKey = 0x70686f6e65626b31;
+    constexpr char kLastTrigramIndex[] = "idx_contacts_search_key_trgm";
+}
+
+const std::vector<Migration> &SchemaMigrator::migrations()
+{
+    static const std::vector<Migration> steps = {
+        {1,
+         "contacts and phones",
+         {"CREATE TABLE IF NOT EXISTS contacts ("
+          "id BIGSERIAL PRIMARY KEY,"
+          "first_name TEXT NOT NULL,"
+          "last_name TEXT NOT NULL,"
+          "middle_name TEXT NOT NULL DEFAULT '',"
+          "address TEXT NOT NULL DEFAULT '',"
+          "birth_date DATE,"
+          "email TEXT NOT NULL"
+          ");",
+          "CREATE TABLE IF NOT EXISTS phones ("
+          "id BIGSERIAL PRIMARY KEY,"
+          "contact_id BIGINT NOT NULL REFERENCES contacts(id) ON DELETE CASCADE,"
+          "type SMALLINT NOT NULL,"
+          "value TEXT NOT NULL"
+          ");",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_last_name ON contacts(last_name);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_first_name ON contacts(first_name);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_email ON contacts(email);",
+          "CREATE INDEX IF NOT EXISTS idx_phones_value ON phones(value);",
+          "CREATE INDEX IF NOT EXISTS idx_phones_contact_id ON phones(contact_id);"}},
+        {2,
+         "trigram search indexes",
+         {"CREATE INDEX IF NOT EXISTS idx_contacts_name_order ON contacts(last_name, first_name, id);"},
+         {"DROP INDEX IF EXISTS idx_contacts_last_name;",
+          "DROP INDEX IF EXISTS idx_contacts_first_name;",
+          "DROP INDEX IF EXISTS idx_contacts_email;",
+          "DROP INDEX IF EXISTS idx_phones_value;",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_first_name_trgm ON contacts USING gin (first_name gin_trgm_ops);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_last_name_trgm ON contacts USING gin (last_name gin_trgm_ops);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_middle_name_trgm ON contacts USING gin (middle_name gin_trgm_ops);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_email_trgm ON contacts USING gin (email gin_trgm_ops);",
+          "CREATE INDEX IF NOT EXISTS idx_phones_value_trgm ON phones USING gin (value gin_trgm_ops);"}},
+        {3,
+         "change notifications",
+         {"CREATE OR REPLACE FUNCTION phonebook_notify_change() RETURNS trigger AS $$ "
+          "DECLARE changed BIGINT; "
+          "BEGIN "
+          "IF TG_TABLE_NAME = 'phones' THEN "
+          "changed := CASE WHEN TG_OP = 'DELETE' THEN OLD.contact_id ELSE NEW.contact_id END; "
+          "ELSE "
+          "changed := CASE WHEN TG_OP = 'DELETE' THEN OLD.id ELSE NEW.id END; "
+          "END IF; "
+          "PERFORM pg_notify('phonebook_changes', changed::text); "
+          "RETURN NULL; "
+          "END $$ LANGUAGE plpgsql;",
+          "CREATE TRIGGER contacts_notify_change AFTER INSERT OR UPDATE OR DELETE ON contacts "
+          "FOR EACH ROW EXECUTE PROCEDURE phonebook_notify_change();",
+          "CREATE TRIGGER phones_notify_change AFTER INSERT OR UPDATE OR DELETE ON phones "
+          "FOR EACH ROW EXECUTE PROCEDURE phonebook_notify_change();"}},
+        {4,
+         "keyset indexes per sort column",
+         {"DROP INDEX IF EXISTS idx_contacts_name_order;",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_last_name_id ON contacts(last_name, id);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_first_name_id ON contacts(first_name, id);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_middle_name_id ON contacts(middle_name, id);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_email_id ON contacts(email, id);",
+          "CREATE INDEX IF NOT EXISTS idx_contacts_birth_date_id ON contacts((COALESCE(birth_date, DATE '0001-01-01')), id);"}},
+        {5,
+         "normalized search keys",
+         {"ALTER TABLE contacts ADD COLUMN IF NOT EXISTS search_key TEXT NOT NULL DEFAULT '';"},
+         {"CREATE INDEX IF NOT EXISTS idx_contacts_search_key_trgm ON contacts USING gin (search_key gin_trgm_ops);"}},
+        {6,
+         "rows awaiting a search key",
+         {"CREATE INDEX IF NOT EXISTS idx_contacts_search_key_missing ON contacts(id) WHERE search_key = '';"}},
+    };
+    return steps;
+}
+
+int SchemaMigrator::latestVersion()
+{
+    return migrations().empty() ? 0 : migrations().back().version;
+}
+
+SchemaMigrator::SchemaMigrator(QSqlDatabase database)
+    : db_(std::move(database))
+{
+}
+
+int SchemaMigrator::currentVersion() const
+{
+    return currentVersion_;
+}
+
+QString SchemaMigrator::lastError() const
+{
+    return lastError_;
+}
+
+bool SchemaMigrator::migrate()
+{
+    lastError_.clear();
+
+    int version = 0;
+    if (readVersion(version) && version == latestVersion() && !trigramIndexesMissing())
+    {
+        currentVersion_ = version;
+        return true;
+    }
+
+    if (!db_.transaction())
+    {
+        lastError_ = db_.lastError().text();
+        qCWarning(logDb) << "migration transaction failed:" << lastError_;
+        return false;
+    }
+
+    if (!applyPending())
+    {
+        db_.rollback();
+        return false;
+    }
+
+    if (!db_.commit())
+    {
+        lastError_ = db_.lastError().text();
+        qCWarning(logDb) << "migration commit failed:" << lastError_;
+        db_.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+bool SchemaMigrator::readVersion(int &version)
+{
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT COALESCE(MAX(version), 0) FROM schema_version;") || !q.next())
+        return false;
+
+    version = q.value(0).toInt();
+    return true;
+}
+
+bool SchemaMigrator::applyPending()
+{
+    if (!exec(QString("SELECT pg_advisory_xact_lock(%1);").arg(kMigrationLockKey), "migration lock"))
+        return false;
+
+    if (!exec("CREATE TABLE IF NOT EXISTS schema_version ("
+              "version INTEGER PRIMARY KEY,"
+              "description TEXT NOT NULL,"
+              "applied_at TIMESTAMPTZ NOT NULL DEFAULT now()"
+              ");",
+              "create schema_version"))
+        return false;
+
+    int version = 0;
+    if (!readVersion(version))
+    {
+        lastError_ = "cannot read schema_version";
+        qCWarning(logDb) << lastError_;
+        return false;
+    }
+
+    if (version > latestVersion())
+    {
+        lastError_ = QString("DB schema version %1 is newer than supported %2").arg(version).arg(latestVersion());
+        qCWarning(logDb) << lastError_;
+        return false;
+    }
+
+    const bool trigram = trigramInstalled();
+    if (!trigram)
+    {
+        qCWarning(logDb) << "pg_trgm extension is not installed; trigram search indexes are skipped."
+                         << "Ask a superuser to run CREATE EXTENSION pg_trgm; they are built on the next connect.";
+    }
+
+    for (const Migration &m : migrations())
+    {
+        if (m.version <= version)
+        {
+            if (trigram && !execAll(m.trigramStatements))
+                return false;
+            continue;
+        }
+
+        if (!execAll(m.statements) || (trigram && !execAll(m.trigramStatements)))
+            return false;
+
+        QSqlQuery record(db_);
+        record.prepare("INSERT INTO schema_version(version, description) VALUES(?, ?);");
+        record.addBindValue(m.version);
+        record.addBindValue(m.description);
+        if (!record.exec())
+        {
+            lastError_ = record.lastError().text();
+            qCWarning(logDb) << "schema_version insert failed:" << lastError_;
+            return false;
+        }
+
+        qCInfo(logDb) << "Applied migration" << m.version << m.description;
+        version = m.version;
+    }
+
+    currentVersion_ = version;
+    return true;
+}
+
+bool SchemaMigrator::trigramInstalled()
+{
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    return q.exec("SELECT 1 FROM pg_extension WHERE extname = 'pg_trgm';") && q.next();
+}
+
+bool SchemaMigrator::trigramIndexesMissing()
+{
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    q.prepare("SELECT EXISTS(SELECT 1 FROM pg_extension WHERE extname = 'pg_trgm') "
+              "AND NOT EXISTS(SELECT 1 FROM pg_indexes WHERE indexname = ?);");
+    q.addBindValue(QString::fromLatin1(kLastTrigramIndex));
+    return q.exec() && q.next() && q.value(0).toBool();
+}
+
+bool SchemaMigrator::execAll(const QStringList &statements)
+{
+    for (const QString &sql : statements)
+    {
+        if (!exec(sql, "migration step"))
+            return false;
+    }
+    return true;
+}
+
+bool SchemaMigrator::exec(const QString &sql, const char *what)
+{
+    QSqlQuery q(db_);
+    if (q.exec(sql))
+        return true;
+
+    lastError_ = q.lastError().text();
+    qCWarning(logDb) << what << "failed:" << lastError_;
+    return false;
+}
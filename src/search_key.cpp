@@ -0,0 +1,76 @@
+#include "search_key.hpp"
+
+namespace
+{
+    const char *const kCyrillicToLatin[] = {
+        "a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o", "p",
+        "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"};
+
+    constexpr ushort kCyrillicA = 0x0430;
+    constexpr ushort kCyrillicYa = 0x044f;
+    constexpr ushort kCyrillicYo = 0x0451;
+
+    void appendNormalized(QByteArray &out, const QString &text)
+    {
+        const QString folded = text.toCaseFolded();
+        for (int i = 0; i < folded.size(); ++i)
+        {
+            const ushort u = folded.at(i).unicode();
+            if (u < 0x80)
+            {
+                out.append(static_cast<char>(u));
+            }
+            else if (u >= kCyrillicA && u <= kCyrillicYa)
+            {
+                out.append(kCyrillicToLatin[u - kCyrillicA]);
+            }
+            else if (u == kCyrillicYo)
+            {
+                out.append('e');
+            }
+            else if (folded.at(i).isHighSurrogate() && i + 1 < folded.size())
+            {
+                out.append(folded.mid(i, 2).toUtf8());
+                ++i;
+            }
+            else
+            {
+                out.append(QString(folded.at(i)).toUtf8());
+            }
+        }
+    }
+}
+
+QByteArray SearchKey::normalize(const QString &text)
+{
+    QByteArray out;
+    out.reserve(text.size() + 8);
+    appendNormalized(out, text.trimmed());
+    return out;
+}
+
+QByteArray SearchKey::forContact(const Contact &contact)
+{
+    QByteArray out;
+    out.reserve(128);
+
+    appendNormalized(out, contact.lastName());
+    out.append('\n');
+    appendNormalized(out, contact.firstName());
+    out.append('\n');
+    appendNormalized(out, contact.middleName());
+    out.append('\n');
+    appendNormalized(out, contact.email());
+    out.append('\n');
+    if (contact.birthDate().isValid())
+        out.append(contact.birthDate().toString("dd.MM.yyyy").toLatin1());
+
+    for (const PhoneNumber &p : contact.phoneNumbers())
+    {
+        out.append('\n');
+        appendNormalized(out, p.value());
+        out.append('\n');
+        out.append(p.digits());
+    }
+    return out;
+}
@@ -0,0 +1,291 @@
+#include "sorted_permutation.hpp"
+
+#include <algorithm>
+
+void SortedPermutation::build(const std::vector<QByteArray> *keys, const std::vector<int> &sortedRows)
+{
+    keys_ = keys;
+
+    const std::size_t n = keys->size();
+    left_.assign(n, -1);
+    right_.assign(n, -1);
+    parent_.assign(n, -1);
+    size_.assign(n, 1);
+    priority_.resize(n);
+    for (quint32 &p : priority_)
+        p = nextPriority();
+
+    std::vector<int> spine;
+    for (const int row : sortedRows)
+    {
+        int last = -1;
+        while (!spine.empty() && priority_[static_cast<std::size_t>(spine.back())] < priority_[static_cast<std::size_t>(row)])
+        {
+            last = spine.back();
+            spine.pop_back();
+        }
+
+        left_[static_cast<std::size_t>(row)] = last;
+        if (last >= 0)
+            parent_[static_cast<std::size_t>(last)] = row;
+
+        if (!spine.empty())
+        {
+            right_[static_cast<std::size_t>(spine.back())] = row;
+            parent_[static_cast<std::size_t>(row)] = spine.back();
+        }
+        spine.push_back(row);
+    }
+    root_ = spine.empty() ? -1 : spine.front();
+
+    std::vector<int> stack;
+    std::vector<int> postOrder;
+    postOrder.reserve(n);
+    if (root_ >= 0)
+        stack.push_back(root_);
+    while (!stack.empty())
+    {
+        const int node = stack.back();
+        stack.pop_back();
+        postOrder.push_back(node);
+        if (left_[static_cast<std::size_t>(node)] >= 0)
+            stack.push_back(left_[static_cast<std::size_t>(node)]);
+        if (right_[static_cast<std::size_t>(node)] >= 0)
+            stack.push_back(right_[static_cast<std::size_t>(node)]);
+    }
+    for (auto it = postOrder.rbegin(); it != postOrder.rend(); ++it)
+        size_[static_cast<std::size_t>(*it)] = 1 + sizeOf(left_[static_cast<std::size_t>(*it)]) + sizeOf(right_[static_cast<std::size_t>(*it)]);
+}
+
+void SortedPermutation::clear()
+{
+    keys_ = nullptr;
+    left_.clear();
+    right_.clear();
+    parent_.clear();
+    size_.clear();
+    priority_.clear();
+    left_.shrink_to_fit();
+    right_.shrink_to_fit();
+    parent_.shrink_to_fit();
+    size_.shrink_to_fit();
+    priority_.shrink_to_fit();
+    root_ = -1;
+}
+
+bool SortedPermutation::isBuilt() const
+{
+    return keys_ != nullptr;
+}
+
+int SortedPermutation::size() const
+{
+    return sizeOf(root_);
+}
+
+void SortedPermutation::insert(int row)
+{
+    const std::size_t i = static_cast<std::size_t>(row);
+    while (left_.size() <= i)
+    {
+        left_.push_back(-1);
+        right_.push_back(-1);
+        parent_.push_back(-1);
+        size_.push_back(1);
+        priority_.push_back(nextPriority());
+    }
+
+    left_[i] = -1;
+    right_[i] = -1;
+    parent_[i] = -1;
+    size_[i] = 1;
+
+    int lo = -1;
+    int hi = -1;
+    split(root_, row, lo, hi);
+    root_ = merge(merge(lo, row), hi);
+    parent_[static_cast<std::size_t>(root_)] = -1;
+}
+
+void SortedPermutation::erase(int row)
+{
+    const std::size_t i = static_cast<std::size_t>(row);
+    if (i >= parent_.size() || (parent_[i] < 0 && root_ != row))
+        return;
+
+    const int joined = merge(left_[i], right_[i]);
+    const int up = parent_[i];
+
+    if (joined >= 0)
+        parent_[static_cast<std::size_t>(joined)] = up;
+
+    if (up < 0)
+    {
+        root_ = joined;
+    }
+    else
+    {
+        if (left_[static_cast<std::size_t>(up)] == row)
+            left_[static_cast<std::size_t>(up)] = joined;
+        else
+            right_[static_cast<std::size_t>(up)] = joined;
+
+        for (int node = up; node >= 0; node = parent_[static_cast<std::size_t>(node)])
+            --size_[static_cast<std::size_t>(node)];
+    }
+
+    left_[i] = -1;
+    right_[i] = -1;
+    parent_[i] = -1;
+    size_[i] = 1;
+}
+
+int SortedPermutation::at(int rank) const
+{
+    int node = root_;
+    while (node >= 0)
+    {
+        const int leftSize = sizeOf(left_[static_cast<std::size_t>(node)]);
+        if (rank < leftSize)
+        {
+            node = left_[static_cast<std::size_t>(node)];
+        }
+        else if (rank == leftSize)
+        {
+            return node;
+        }
+        else
+        {
+            rank -= leftSize + 1;
+            node = right_[static_cast<std::size_t>(node)];
+        }
+    }
+    return -1;
+}
+
+std::vector<int> SortedPermutation::inOrder() const
+{
+    std::vector<int> out;
+    out.reserve(static_cast<std::size_t>(size()));
+
+    std::vector<int> stack;
+    int node = root_;
+    while (node >= 0 || !stack.empty())
+    {
+        while (node >= 0)
+        {
+            stack.push_back(node);
+            node = left_[static_cast<std::size_t>(node)];
+        }
+        node = stack.back();
+        stack.pop_back();
+        out.push_back(node);
+        node = right_[static_cast<std::size_t>(node)];
+    }
+    return out;
+}
+
+int SortedPermutation::rankOf(int row) const
+{
+    int rank = sizeOf(left_[static_cast<std::size_t>(row)]);
+    for (int node = row; parent_[static_cast<std::size_t>(node)] >= 0; node = parent_[static_cast<std::size_t>(node)])
+    {
+        const int up = parent_[static_cast<std::size_t>(node)];
+        if (right_[static_cast<std::size_t>(up)] == node)
+            rank += sizeOf(left_[static_cast<std::size_t>(up)]) + 1;
+    }
+    return rank;
+}
+
+int SortedPermutation::countLess(const QByteArray &key, int row) const
+{
+    int count = 0;
+    int node = root_;
+    while (node >= 0)
+    {
+        const QByteArray &k = (*keys_)[static_cast<std::size_t>(node)];
+        if (k < key || (k == key && node < row))
+        {
+            count += sizeOf(left_[static_cast<std::size_t>(node)]) + 1;
+            node = right_[static_cast<std::size_t>(node)];
+        }
+        else
+        {
+            node = left_[static_cast<std::size_t>(node)];
+        }
+    }
+    return count;
+}
+
+quint32 SortedPermutation::nextPriority()
+{
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+}
+
+int SortedPermutation::sizeOf(int node) const
+{
+    return node < 0 ? 0 : size_[static_cast<std::size_t>(node)];
+}
+
+bool SortedPermutation::less(int a, int b) const
+{
+    const QByteArray &ka = (*keys_)[static_cast<std::size_t>(a)];
+    const QByteArray &kb = (*keys_)[static_cast<std::size_t>(b)];
+    return ka < kb || (ka == kb && a < b);
+}
+
+void SortedPermutation::pull(int node)
+{
+    const std::size_t i = static_cast<std::size_t>(node);
+    size_[i] = 1 + sizeOf(left_[i]) + sizeOf(right_[i]);
+    if (left_[i] >= 0)
+        parent_[static_cast<std::size_t>(left_[i])] = node;
+    if (right_[i] >= 0)
+        parent_[static_cast<std::size_t>(right_[i])] = node;
+}
+
+void SortedPermutation::split(int node, int pivot, int &lo, int &hi)
+{
+    if (node < 0)
+    {
+        lo = -1;
+        hi = -1;
+        return;
+    }
+
+    const std::size_t i = static_cast<std::size_t>(node);
+    if (less(node, pivot))
+    {
+        split(right_[i], pivot, right_[i], hi);
+        pull(node);
+        lo = node;
+    }
+    else
+    {
+        split(left_[i], pivot, lo, left_[i]);
+        pull(node);
+        hi = node;
+    }
+}
+
+int SortedPermutation::merge(int lo, int hi)
+{
+    if (lo < 0)
+        return hi;
+    if (hi < 0)
+        return lo;
+
+    if (priority_[static_cast<std::size_t>(lo)] > priority_[static_cast<std::size_t>(hi)])
+    {
+        right_[static_cast<std::size_t>(lo)] = merge(right_[static_cast<std::size_t>(lo)], hi);
+        pull(lo);
+        return lo;
+    }
+
+    left_[static_cast<std::size_t>(hi)] = merge(lo, left_[static_cast<std::size_t>(hi)]);
+    pull(hi);
+    return hi;
+}
@@ -0,0 +1,196 @@
+#include "text_scanner.hpp"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define PHONEBOOK_SCAN_SSE2 1
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PHONEBOOK_SCAN_AVX2 1
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PHONEBOOK_SCAN_NEON 1
+#endif
+
+namespace
+{
+    inline bool isSpecial(char ch)
+    {
+        return ch == '|' || ch == ',' || ch == ':' || ch == '\\' || ch == '\n';
+    }
+
+    inline bool needsEscape(char ch)
+    {
+        return ch == '|' || ch == ',' || ch == '\\' || ch == '\n';
+    }
+
+#if defined(PHONEBOOK_SCAN_AVX2)
+    __attribute__((target("avx2"))) const char *findSpecialAvx2(const char *p, const char *end)
+    {
+        const __m256i pipe = _mm256_set1_epi8('|');
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i colon = _mm256_set1_epi8(':');
+        const __m256i slash = _mm256_set1_epi8('\\');
+        const __m256i newline = _mm256_set1_epi8('\n');
+
+        while (end - p >= 32)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            const __m256i hit = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, pipe), _mm256_cmpeq_epi8(v, comma)),
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, slash)),
+                                _mm256_cmpeq_epi8(v, newline)));
+            const quint32 mask = static_cast<quint32>(_mm256_movemask_epi8(hit));
+            if (mask)
+                return p + qCountTrailingZeroBits(mask);
+            p += 32;
+        }
+        return p;
+    }
+
+    bool hasAvx2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+}
+
+const char *findSpecialByteScalar(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while (p < end && !isSpecial(*p))
+        ++p;
+    return p;
+}
+
+const char *findSpecialByte(const char *begin, const char *end)
+{
+    const char *p = begin;
+
+#if defined(PHONEBOOK_SCAN_AVX2)
+    if (end - p >= 32 && hasAvx2())
+    {
+        p = findSpecialAvx2(p, end);
+        if (end - p >= 32)
+            return p;
+    }
+#endif
+
+#if defined(PHONEBOOK_SCAN_SSE2)
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (end - p >= 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, pipe), _mm_cmpeq_epi8(v, comma)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, slash)),
+                         _mm_cmpeq_epi8(v, newline)));
+        const quint32 mask = static_cast<quint32>(_mm_movemask_epi8(hit));
+        if (mask)
+            return p + qCountTrailingZeroBits(mask);
+        p += 16;
+    }
+#elif defined(PHONEBOOK_SCAN_NEON)
+    const uint8x16_t pipe = vdupq_n_u8('|');
+    const uint8x16_t comma = vdupq_n_u8(',');
+    const uint8x16_t colon = vdupq_n_u8(':');
+    const uint8x16_t slash = vdupq_n_u8('\\');
+    const uint8x16_t newline = vdupq_n_u8('\n');
+
+    while (end - p >= 16)
+    {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        const uint8x16_t hit = vorrq_u8(
+            vorrq_u8(vceqq_u8(v, pipe), vceqq_u8(v, comma)),
+            vorrq_u8(vorrq_u8(vceqq_u8(v, colon), vceqq_u8(v, slash)), vceqq_u8(v, newline)));
+        if (vmaxvq_u8(hit))
+            break;
+        p += 16;
+    }
+#endif
+
+    return findSpecialByteScalar(p, end);
+}
+
+const char *scanField(const char *begin, const char *end, char delimiter, FieldRange &field)
+{
+    field.begin = begin;
+    field.escaped = false;
+
+    const char *p = begin;
+    while (p < end)
+    {
+        p = findSpecialByte(p, end);
+        if (p == end || *p == delimiter)
+            break;
+
+        if (*p == '\\')
+        {
+            field.escaped = true;
+            p = (end - p > 1) ? p + 2 : end;
+            continue;
+        }
+
+        ++p;
+    }
+
+    field.end = p;
+    return p;
+}
+
+QString decodeField(const FieldRange &field)
+{
+    const int size = static_cast<int>(field.end - field.begin);
+    if (!field.escaped)
+        return QString::fromUtf8(field.begin, size);
+
+    thread_local QByteArray scratch;
+    scratch.resize(size);
+    char *out = scratch.data();
+
+    const char *p = field.begin;
+    while (p < field.end)
+    {
+        const char *slash = static_cast<const char *>(std::memchr(p, '\\', static_cast<std::size_t>(field.end - p)));
+        const char *runEnd = slash ? slash : field.end;
+        std::memcpy(out, p, static_cast<std::size_t>(runEnd - p));
+        out += runEnd - p;
+        if (!slash)
+            break;
+
+        if (slash + 1 < field.end)
+            *out++ = slash[1];
+        p = slash + 2;
+    }
+
+    return QString::fromUtf8(scratch.constData(), static_cast<int>(out - scratch.constData()));
+}
+
+void appendEscaped(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    const char *p = utf8.constData();
+    const char *end = p + utf8.size();
+
+    while (p < end)
+    {
+        const char *special = findSpecialByte(p, end);
+        out.append(p, static_cast<int>(special - p));
+        if (special == end)
+            break;
+
+        if (needsEscape(*special))
+            out.append('\\');
+        out.append(*special);
+        p = special + 1;
+    }
+}